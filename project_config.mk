@@ -26,13 +26,16 @@ LDFLAGS :=
 override CXXFLAGS += -include src/utils/common.h -include src/program/parachute.h -Isrc -Ilib/include $(subst -Dmain,-D_main_,$(sort $(deps_compiler_flags)))
 override CXXFLAGS += -Ilib/include/cglfl_gl3.2_core # OpenGL version
 override LDFLAGS += $(filter-out -mwindows,$(deps_linker_flags))
+ifneq ($(TARGET_OS),windows)
+override LDFLAGS += -pthread # For std::thread (probe writer, ParallelFor).
+endif
 
 # Build modes
 $(call new_mode,debug)
-$(mode_flags) CXXFLAGS += -g -D_GLIBCXX_ASSERTIONS
+$(mode_flags) CXXFLAGS += -g -D_GLIBCXX_ASSERTIONS -DCIRCUIT_PROFILING
 
 $(call new_mode,debug_hard)
-$(mode_flags) CXXFLAGS += -g -D_GLIBCXX_DEBUG
+$(mode_flags) CXXFLAGS += -g -D_GLIBCXX_DEBUG -DCIRCUIT_PROFILING
 
 $(call new_mode,release)
 $(mode_flags) CXXFLAGS += -DNDEBUG -O3
@@ -0,0 +1,114 @@
+#include "activity_map.h"
+
+#include <algorithm>
+#include <bit>
+#include <unordered_map>
+
+namespace Components
+{
+    std::uint64_t ActivityMap::PackOutPoints(const BasicNode &node)
+    {
+        std::uint64_t ret = 0;
+        int count = std::min(node.OutPointCount(), 64);
+        for (int i = 0; i < count; i++)
+            ret |= std::uint64_t(node.GetOutPoint(i).is_powered) << i;
+        return ret;
+    }
+
+    void ActivityMap::SyncWithCircuit(const Circuit &circuit)
+    {
+        bool in_sync = entries.size() == circuit.nodes.size();
+        for (std::size_t i = 0; in_sync && i < entries.size(); i++)
+            in_sync = entries[i].id == circuit.nodes[i]->id;
+        if (in_sync)
+            return;
+
+        std::unordered_map<BasicNode::id_t, Entry> old_entries;
+        for (Entry &entry : entries)
+            old_entries.try_emplace(entry.id, entry);
+
+        entries.clear();
+        entries.reserve(circuit.nodes.size());
+        for (const NodeStorage &node : circuit.nodes)
+        {
+            auto it = old_entries.find(node->id);
+            if (it != old_entries.end())
+            {
+                entries.push_back(it->second);
+            }
+            else
+            {
+                Entry &entry = entries.emplace_back();
+                entry.id = node->id;
+                entry.prev_bits = PackOutPoints(*node);
+            }
+        }
+    }
+
+    auto ActivityMap::FindEntry(BasicNode::id_t id) const -> const Entry *
+    {
+        auto it = std::lower_bound(entries.begin(), entries.end(), id, [](const Entry &entry, BasicNode::id_t id){return entry.id < id;});
+        if (it == entries.end() || it->id != id)
+            return nullptr;
+        return &*it;
+    }
+
+    void ActivityMap::Reset()
+    {
+        entries.clear();
+        cur_bucket = 0;
+        ticks_in_cur_bucket = 0;
+        ticks_in_window = 0;
+        window_is_full = false;
+    }
+
+    void ActivityMap::AddTick(const Circuit &circuit)
+    {
+        SyncWithCircuit(circuit);
+
+        // Advance to the next bucket, dropping its old contents from the totals.
+        if (ticks_in_cur_bucket == bucket_ticks)
+        {
+            ticks_in_cur_bucket = 0;
+            cur_bucket = (cur_bucket + 1) % bucket_count;
+            if (cur_bucket == 0)
+                window_is_full = true;
+            if (window_is_full)
+                ticks_in_window -= bucket_ticks;
+            for (Entry &entry : entries)
+            {
+                entry.total -= entry.buckets[cur_bucket];
+                entry.buckets[cur_bucket] = 0;
+            }
+        }
+
+        for (std::size_t i = 0; i < entries.size(); i++)
+        {
+            Entry &entry = entries[i];
+            std::uint64_t bits = PackOutPoints(*circuit.nodes[i]);
+            int toggles = std::popcount(bits ^ entry.prev_bits);
+            entry.prev_bits = bits;
+            entry.buckets[cur_bucket] += toggles;
+            entry.total += toggles;
+        }
+
+        ticks_in_cur_bucket++;
+        ticks_in_window++;
+    }
+
+    float ActivityMap::NodeActivity(BasicNode::id_t id) const
+    {
+        const Entry *entry = FindEntry(id);
+        if (!entry || ticks_in_window == 0)
+            return 0;
+        return entry->total / float(ticks_in_window);
+    }
+
+    bool ActivityMap::NodeIsDead(BasicNode::id_t id) const
+    {
+        if (!window_is_full)
+            return false;
+        const Entry *entry = FindEntry(id);
+        return entry && entry->total == 0;
+    }
+}
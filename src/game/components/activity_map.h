@@ -0,0 +1,55 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "game/components/circuit.h"
+
+namespace Components
+{
+    // Counts how often the 'out' points of each node toggle, over a sliding window of ticks.
+    // Per tick, each node costs one XOR of its packed out point states and a popcount.
+    class ActivityMap
+    {
+      public:
+        static constexpr int bucket_ticks = 30, bucket_count = 8;
+        static constexpr int window_ticks = bucket_ticks * bucket_count;
+
+      private:
+        struct Entry
+        {
+            BasicNode::id_t id = 0;
+            std::uint64_t prev_bits = 0; // Only the first 64 'out' points are tracked.
+            std::array<std::uint16_t, bucket_count> buckets{};
+            std::uint32_t total = 0; // Sum of `buckets`.
+        };
+
+        std::vector<Entry> entries; // Parallel to `Circuit::nodes` as of the last `AddTick()`, so it's sorted by id.
+        int cur_bucket = 0;
+        int ticks_in_cur_bucket = 0;
+        int ticks_in_window = 0; // The amount of ticks in all buckets, including the current partially filled one.
+        bool window_is_full = false; // Set after all buckets were filled at least once.
+
+        static std::uint64_t PackOutPoints(const BasicNode &node);
+        // Makes `entries` parallel to `circuit.nodes` again, after nodes were added or removed.
+        void SyncWithCircuit(const Circuit &circuit);
+        // Returns null if there's no entry for this node.
+        [[nodiscard]] const Entry *FindEntry(BasicNode::id_t id) const;
+
+      public:
+        ActivityMap() {}
+
+        void Reset();
+
+        // Call this after each circuit tick.
+        void AddTick(const Circuit &circuit);
+
+        // Returns the average amount of toggles per tick of the node, over the window.
+        // Returns 0 if the node is unknown (e.g. it was just added).
+        [[nodiscard]] float NodeActivity(BasicNode::id_t id) const;
+        // Returns true if all buckets were filled at least once, and the node didn't toggle during the window.
+        [[nodiscard]] bool NodeIsDead(BasicNode::id_t id) const;
+    };
+}
@@ -0,0 +1,214 @@
+#include "breakpoints.h"
+
+#include <cctype>
+#include <limits>
+
+#include "program/errors.h"
+
+namespace Components
+{
+    std::vector<Breakpoints::Term> Breakpoints::Parse(const std::string &expression)
+    {
+        std::vector<Term> ret;
+
+        const char *cur = expression.c_str();
+        auto SkipWhitespace = [&]{while (std::isspace((unsigned char)*cur)) cur++;};
+        auto ReadNumber = [&](auto &target, const char *what)
+        {
+            if (!std::isdigit((unsigned char)*cur))
+                Program::Error("Expected ", what, " at position ", cur - expression.c_str(), " in breakpoint `", expression, "`.");
+            using type = std::remove_reference_t<decltype(target)>;
+            unsigned long long value = 0;
+            while (std::isdigit((unsigned char)*cur))
+            {
+                value = value * 10 + (*cur++ - '0');
+                if (value > (unsigned long long)std::numeric_limits<type>::max())
+                    Program::Error("The ", what, " is too large in breakpoint `", expression, "`.");
+            }
+            target = type(value);
+        };
+
+        while (true)
+        {
+            SkipWhitespace();
+
+            Term &term = ret.emplace_back();
+            switch (*cur)
+            {
+                case '!': term.kind = TermKind::unpowered; cur++; break;
+                case '^': term.kind = TermKind::rises;     cur++; break;
+                case 'v': term.kind = TermKind::falls;     cur++; break;
+                case '~': term.kind = TermKind::changes;   cur++; break;
+                default:  term.kind = TermKind::powered;          break;
+            }
+
+            ReadNumber(term.node, "node id");
+            if (*cur == '.')
+            {
+                cur++;
+                ReadNumber(term.point, "point index");
+            }
+
+            SkipWhitespace();
+            if (!*cur)
+                break;
+            if (*cur != '&')
+                Program::Error("Expected `&` at position ", cur - expression.c_str(), " in breakpoint `", expression, "`.");
+            cur++;
+        }
+
+        return ret;
+    }
+
+    std::string Breakpoints::TermToString(const Term &term)
+    {
+        std::string ret;
+        switch (term.kind)
+        {
+            case TermKind::powered:   break;
+            case TermKind::unpowered: ret += '!'; break;
+            case TermKind::rises:     ret += '^'; break;
+            case TermKind::falls:     ret += 'v'; break;
+            case TermKind::changes:   ret += '~'; break;
+        }
+        ret += std::to_string(term.node);
+        if (term.point != 0)
+            ret += Str(".", term.point);
+        return ret;
+    }
+
+    void Breakpoints::Add(std::string expression)
+    {
+        Breakpoint &breakpoint = breakpoints.emplace_back();
+        try
+        {
+            breakpoint.terms = Parse(expression);
+        }
+        catch (...)
+        {
+            breakpoints.pop_back();
+            throw;
+        }
+        breakpoint.expression = std::move(expression);
+        need_recompile = true;
+    }
+
+    void Breakpoints::Modify(std::size_t index, std::string expression)
+    {
+        Breakpoint &breakpoint = breakpoints.at(index);
+        breakpoint.terms = Parse(expression);
+        breakpoint.expression = std::move(expression);
+        breakpoint.hit_count = 0;
+        need_recompile = true;
+    }
+
+    void Breakpoints::SetEnabled(std::size_t index, bool enabled)
+    {
+        breakpoints.at(index).enabled = enabled;
+        need_recompile = true;
+    }
+
+    void Breakpoints::Remove(std::size_t index)
+    {
+        breakpoints.erase(breakpoints.begin() + index);
+        need_recompile = true;
+    }
+
+    void Breakpoints::Compile(const Circuit &circuit)
+    {
+        need_recompile = false;
+        compiled_terms.clear();
+        compiled_breakpoints.clear();
+        compiled_node_ids.clear();
+        compiled_generation = circuit.Generation();
+
+        for (std::size_t i = 0; i < breakpoints.size(); i++)
+        {
+            const Breakpoint &breakpoint = breakpoints[i];
+            if (!breakpoint.enabled)
+                continue;
+
+            CompiledBreakpoint &compiled_breakpoint = compiled_breakpoints.emplace_back();
+            compiled_breakpoint.breakpoint_index = i;
+            compiled_breakpoint.terms_begin = compiled_terms.size();
+
+            for (const Term &term : breakpoint.terms)
+            {
+                CompiledTerm &compiled_term = compiled_terms.emplace_back();
+                compiled_term.kind = term.kind;
+                compiled_term.point = -1;
+
+                const NodeStorage *node = circuit.FindNodeIfExists(term.node);
+                if (node)
+                {
+                    compiled_term.node_index = node - circuit.nodes.data();
+                    if (term.point >= 0 && term.point < (*node)->OutPointCount())
+                        compiled_term.point = term.point;
+                }
+                compiled_node_ids.push_back(term.node);
+            }
+
+            compiled_breakpoint.terms_end = compiled_terms.size();
+        }
+    }
+
+    std::size_t Breakpoints::Check(const Circuit &circuit)
+    {
+        // Recompile if nodes were added or removed, e.g. by an undo or a paste.
+        if (circuit.Generation() != compiled_generation)
+            need_recompile = true;
+
+        // Recompile if the nodes were moved around in the list, or if a missing node reappeared.
+        for (std::size_t i = 0; !need_recompile && i < compiled_terms.size(); i++)
+        {
+            const CompiledTerm &term = compiled_terms[i];
+            if (term.node_index == std::uint32_t(-1))
+            {
+                if (circuit.FindNodeIfExists(compiled_node_ids[i]))
+                    need_recompile = true;
+            }
+            else if (term.node_index >= circuit.nodes.size() || circuit.nodes[term.node_index]->id != compiled_node_ids[i])
+            {
+                need_recompile = true;
+            }
+        }
+        if (need_recompile)
+            Compile(circuit);
+
+        std::size_t ret = -1;
+
+        for (const CompiledBreakpoint &breakpoint : compiled_breakpoints)
+        {
+            bool fired = true;
+            for (std::uint32_t i = breakpoint.terms_begin; fired && i < breakpoint.terms_end; i++)
+            {
+                const CompiledTerm &term = compiled_terms[i];
+                if (term.point == -1)
+                {
+                    fired = false;
+                    break;
+                }
+
+                // `was_previously_powered` holds the state before this tick, see `Circuit::Tick()`.
+                const BasicNode::OutPoint &point = circuit.nodes[term.node_index]->GetOutPoint(term.point);
+                switch (term.kind)
+                {
+                    case TermKind::powered:   fired = point.is_powered; break;
+                    case TermKind::unpowered: fired = !point.is_powered; break;
+                    case TermKind::rises:     fired = point.is_powered && !point.was_previously_powered; break;
+                    case TermKind::falls:     fired = !point.is_powered && point.was_previously_powered; break;
+                    case TermKind::changes:   fired = point.is_powered != point.was_previously_powered; break;
+                }
+            }
+
+            if (fired)
+            {
+                breakpoints[breakpoint.breakpoint_index].hit_count++;
+                if (ret == std::size_t(-1))
+                    ret = breakpoint.breakpoint_index;
+            }
+        }
+
+        return ret;
+    }
+}
@@ -0,0 +1,87 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "game/components/circuit.h"
+
+namespace Components
+{
+    // Conditions on the circuit state that pause the simulation.
+    //
+    // A breakpoint is a `&`-separated list of terms, and fires when all of them are true. Each term refers to an 'out' point:
+    //     12     - point 0 of node 12 is powered,
+    //     12.1   - point 1 of node 12 is powered,
+    //     !12    - not powered,
+    //     ^12    - became powered on this tick,
+    //     v12    - became unpowered on this tick,
+    //     ~12    - changed on this tick.
+    // Example: `^3 & 7 & !8.1`.
+    //
+    // The breakpoints are compiled into a flat list of terms, with node ids resolved to indices in `Circuit::nodes`.
+    // They are recompiled automatically when the node list changes.
+    class Breakpoints
+    {
+      public:
+        enum class TermKind : std::uint8_t {powered, unpowered, rises, falls, changes};
+
+        struct Term
+        {
+            TermKind kind = TermKind::powered;
+            BasicNode::id_t node = 0;
+            int point = 0;
+        };
+
+        struct Breakpoint
+        {
+            std::string expression;
+            std::vector<Term> terms;
+            bool enabled = true;
+            std::size_t hit_count = 0;
+        };
+
+      private:
+        struct CompiledTerm
+        {
+            std::uint32_t node_index = -1; // -1 if the node doesn't exist.
+            std::int32_t point = 0; // -1 if the node or the point doesn't exist, then the term is always false.
+            TermKind kind = TermKind::powered;
+        };
+        struct CompiledBreakpoint
+        {
+            std::uint32_t breakpoint_index = 0;
+            std::uint32_t terms_begin = 0, terms_end = 0;
+        };
+
+        std::vector<Breakpoint> breakpoints;
+
+        bool need_recompile = true;
+        std::vector<CompiledTerm> compiled_terms;
+        std::vector<CompiledBreakpoint> compiled_breakpoints;
+        std::vector<BasicNode::id_t> compiled_node_ids; // Ids of referenced nodes, parallel to `compiled_terms`. Used to detect changes in the node list.
+        std::uint64_t compiled_generation = 0; // `Circuit::Generation()` at the time of compilation.
+
+        void Compile(const Circuit &circuit);
+
+      public:
+        Breakpoints() {}
+
+        // Throws on a syntax error.
+        [[nodiscard]] static std::vector<Term> Parse(const std::string &expression);
+        [[nodiscard]] static std::string TermToString(const Term &term);
+
+        [[nodiscard]] const std::vector<Breakpoint> &GetBreakpoints() const {return breakpoints;}
+
+        // Throws on a syntax error.
+        void Add(std::string expression);
+        // Throws on a syntax error, then the breakpoint is unchanged.
+        void Modify(std::size_t index, std::string expression);
+        void SetEnabled(std::size_t index, bool enabled);
+        void Remove(std::size_t index);
+
+        // Call this after each circuit tick. Returns the index of the first breakpoint that fired, or -1 if none.
+        [[nodiscard]] std::size_t Check(const Circuit &circuit);
+    };
+}
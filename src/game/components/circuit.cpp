@@ -1,10 +1,15 @@
 #include "circuit.h"
 
+#include <algorithm>
+#include <atomic>
+#include <iterator>
+
 #include "game/draw.h"
 #include "game/gui_style.h"
 #include "game/main.h"
 #include "macros/adjust.h"
 #include "meta/misc.h"
+#include "utils/hash.h"
 
 namespace Components
 {
@@ -40,9 +45,10 @@ namespace Components
                 }
             }
 
-            void Render(ivec2 offset) const override
+            void Render(ivec2 offset, bool unpowered) const override
             {
-                r.iquad(pos + offset, atlas.nodes.region(ivec2(0, 2 + 7*out.is_powered), ivec2(7))).center(ivec2(3));
+                bool powered = out.is_powered && !unpowered;
+                r.iquad(pos + offset, atlas.nodes.region(ivec2(0, 2 + 7*powered), ivec2(7))).center(ivec2(3));
             }
 
             ivec2 GetVisualHalfExtent() const override
@@ -82,9 +88,10 @@ namespace Components
                 }
             }
 
-            void Render(ivec2 offset) const override
+            void Render(ivec2 offset, bool unpowered) const override
             {
-                r.iquad(pos + offset, atlas.nodes.region(ivec2(7, 11*out.is_powered), ivec2(11))).center(ivec2(5));
+                bool powered = out.is_powered && !unpowered;
+                r.iquad(pos + offset, atlas.nodes.region(ivec2(7, 11*powered), ivec2(11))).center(ivec2(5));
             }
 
             ivec2 GetVisualHalfExtent() const override
@@ -147,11 +154,12 @@ namespace Components
                     out.is_powered = true;
             }
 
-            void Render(ivec2 offset) const override
+            void Render(ivec2 offset, bool unpowered) const override
             {
-                r.iquad(pos + offset + point_info_in1.offset_to_node, atlas.nodes.region(ivec2(0, 2 + 7*out.is_powered), ivec2(7))).center(ivec2(3));
-                r.iquad(pos + offset + point_info_in2.offset_to_node, atlas.nodes.region(ivec2(0, 2 + 7*!out.is_powered), ivec2(7))).center(ivec2(3));
-                r.iquad(pos + offset + point_info_out.offset_to_node, atlas.nodes.region(ivec2(0, 2 + 7*out.is_powered), ivec2(7))).center(ivec2(3));
+                bool powered = out.is_powered && !unpowered;
+                r.iquad(pos + offset + point_info_in1.offset_to_node, atlas.nodes.region(ivec2(0, 2 + 7*powered), ivec2(7))).center(ivec2(3));
+                r.iquad(pos + offset + point_info_in2.offset_to_node, atlas.nodes.region(ivec2(0, 2 + 7*!powered), ivec2(7))).center(ivec2(3));
+                r.iquad(pos + offset + point_info_out.offset_to_node, atlas.nodes.region(ivec2(0, 2 + 7*powered), ivec2(7))).center(ivec2(3));
             }
 
             ivec2 GetVisualHalfExtent() const override
@@ -200,9 +208,10 @@ namespace Components
                 out.is_powered = std::all_of(prev_inputs, prev_inputs + time, [](bool x){return x;});
             }
 
-            void Render(ivec2 offset) const override
+            void Render(ivec2 offset, bool unpowered) const override
             {
-                r.iquad(pos + offset, atlas.nodes.region(ivec2(7, 22+11*out.is_powered), ivec2(11))).center(ivec2(5));
+                bool powered = out.is_powered && !unpowered;
+                r.iquad(pos + offset, atlas.nodes.region(ivec2(7, 22+11*powered), ivec2(11))).center(ivec2(5));
             }
 
             ivec2 GetVisualHalfExtent() const override
@@ -221,11 +230,23 @@ namespace Components
 
     bool BasicNode::InPointCon::ConnectionIsPowered(const Circuit &circuit) const
     {
+        IF_CIRCUIT_PROFILING( if (circuit.GetProfiler()) circuit.GetProfiler()->AddConnectionRead(); )
+
         const BasicNode &remote_node = *circuit.FindNodeOrThrow(ids.node);
         const OutPoint &remote_point = remote_node.GetOutPoint(ids.point);
         return remote_point.was_previously_powered ^ is_inverted;
     }
 
+    bool BasicNode::LooksPowered() const
+    {
+        for (int i = 0, count = OutPointCount(); i < count; i++)
+        {
+            if (GetOutPoint(i).is_powered)
+                return true;
+        }
+        return false;
+    }
+
     void BasicNode::DrawConnection(ivec2 window_offset, ivec2 pos_src, ivec2 pos_dst, bool is_inverted, bool is_powered, float src_visual_radius, float dst_visual_radius)
     {
         constexpr int extra_visible_space = 4; // For a good measure.
@@ -363,6 +384,20 @@ namespace Components
             }
         }
 
+        IF_CIRCUIT_PROFILING(
+            if (profiler)
+            {
+                for (NodeStorage &node : nodes)
+                {
+                    profiler->BeginNode(*node);
+                    node->Tick(world, *this);
+                    profiler->EndNode();
+                }
+                profiler->EndTick();
+                return;
+            }
+        )
+
         // For each node, run `Tick()`.
         for (NodeStorage &node : nodes)
         {
@@ -370,19 +405,207 @@ namespace Components
         }
     }
 
+    void Circuit::ValidateNodes(const std::vector<NodeStorage> &nodes)
+    {
+        for (std::size_t i = 1; i < nodes.size(); i++)
+        {
+            if (nodes[i]->id <= nodes[i-1]->id)
+                Program::Error("The circuit nodes are not sorted by id.");
+        }
+
+        for (const NodeStorage &node : nodes)
+        {
+            auto CheckIds = [&](const BasicNode::NodeAndPointId &ids, bool is_out)
+            {
+                auto it = std::lower_bound(nodes.begin(), nodes.end(), ids.node, [](const NodeStorage &node, BasicNode::id_t id){return node->id < id;});
+                if (it == nodes.end() || (*it)->id != ids.node)
+                    Program::Error("Node ", node->id, " is connected to a missing node ", ids.node, ".");
+                const BasicNode &other = **it;
+                if (ids.point < 0 || ids.point >= (is_out ? other.OutPointCount() : other.InPointCount()))
+                    Program::Error("Node ", node->id, " is connected to a missing point ", ids.point, " of node ", ids.node, ".");
+            };
+
+            for (int i = 0, count = node->InPointCount(); i < count; i++)
+            {
+                for (const BasicNode::InPointCon &con : node->GetInPoint(i).connections)
+                    CheckIds(con.ids, true);
+            }
+            for (int i = 0, count = node->OutPointCount(); i < count; i++)
+            {
+                for (const BasicNode::OutPointCon &con : node->GetOutPoint(i).connections)
+                    CheckIds(con.ids, false);
+            }
+        }
+    }
+
+    std::uint64_t Circuit::NewGeneration()
+    {
+        static std::atomic<std::uint64_t> counter = 0;
+        return ++counter;
+    }
+
     void Circuit::SaveState()
     {
         copied_nodes = nodes;
+        copied_generation = generation;
     }
     void Circuit::RestoreState()
     {
         nodes = copied_nodes;
+        generation = copied_generation; // If the nodes were added or removed since `SaveState()`, this still differs from the current value.
+    }
+
+    std::uint64_t Circuit::StateHash() const
+    {
+        // This is saved to replays, so it must be the same on all platforms.
+        std::uint64_t ret = Hash::bytes_seed;
+        Hash::AppendBytes(ret, std::uint64_t(nodes.size()));
+
+        for (const NodeStorage &node : nodes)
+        {
+            std::uint64_t bits = 0;
+            int out_point_count = node->OutPointCount();
+            for (int out_point_index = 0; out_point_index < out_point_count; out_point_index++)
+            {
+                bits = bits << 1 | node->GetOutPoint(out_point_index).is_powered;
+                if ((out_point_index + 1) % 64 == 0 || out_point_index + 1 == out_point_count)
+                {
+                    Hash::AppendBytes(ret, bits);
+                    bits = 0;
+                }
+            }
+        }
+
+        return ret;
     }
 
+    Circuit::Batch::Batch(Circuit &circuit)
+        : circuit(&circuit), first_new_id(circuit.nodes.empty() ? 0 : circuit.nodes.back()->id + 1)
+    {}
 
-    void BasicCustomNode::Render(ivec2 offset) const
+    BasicNode *Circuit::Batch::FindNodeIncludingNew(BasicNode::id_t id)
     {
-        r.iquad(pos + offset, Nodes::atlas.nodes.region(ivec2(18, 10*Custom_IsPowered()), ivec2(13,10))).center(ivec2(6,10));
+        if (id >= first_new_id)
+            return id - first_new_id < new_nodes.size() ? &*new_nodes[id - first_new_id] : nullptr;
+        NodeStorage *node = circuit->FindNodeIfExists(id);
+        return node ? &**node : nullptr;
+    }
+
+    BasicNode::id_t Circuit::Batch::AddNode(NodeStorage node)
+    {
+        DebugAssert("Adding a null node to a circuit batch.", bool(node));
+        node->id = first_new_id + new_nodes.size();
+        return new_nodes.emplace_back(std::move(node))->id;
+    }
+
+    void Circuit::Batch::DeleteNode(BasicNode::id_t id)
+    {
+        deleted_ids.push_back(id);
+    }
+
+    void Circuit::Batch::Connect(BasicNode::NodeAndPointId src_out, BasicNode::NodeAndPointId dst_in, bool is_inverted)
+    {
+        connection_changes.push_back({.src = src_out, .dst = dst_in, .is_inverted = is_inverted, .connect = true});
+    }
+
+    void Circuit::Batch::Disconnect(BasicNode::NodeAndPointId src_out, BasicNode::NodeAndPointId dst_in)
+    {
+        connection_changes.push_back({.src = src_out, .dst = dst_in, .connect = false});
+    }
+
+    void Circuit::Batch::Commit(std::vector<BasicNode::id_t> *changed_ids)
+    {
+        DebugAssert("Circuit batch is not attached to a circuit.", circuit || IsEmpty());
+        if (IsEmpty())
+        {
+            if (changed_ids)
+                changed_ids->clear();
+            return;
+        }
+        DebugAssert("The circuit was modified while a batch was open.", circuit->nodes.empty() || circuit->nodes.back()->id < first_new_id);
+
+        // Validate the connection changes before modifying anything.
+        for (const ConnectionChange &change : connection_changes)
+        {
+            BasicNode *src_node = FindNodeIncludingNew(change.src.node);
+            BasicNode *dst_node = FindNodeIncludingNew(change.dst.node);
+            if (!src_node || !dst_node)
+                Program::Error("Invalid node id in a circuit batch: ", src_node ? change.dst.node : change.src.node, ".");
+            if (change.src.point < 0 || change.src.point >= src_node->OutPointCount() || change.dst.point < 0 || change.dst.point >= dst_node->InPointCount())
+                Program::Error("Invalid connection point index in a circuit batch.");
+        }
+
+        if (changed_ids)
+        {
+            changed_ids->clear();
+            changed_ids->reserve(new_nodes.size() + deleted_ids.size() + connection_changes.size() * 2);
+            for (const NodeStorage &node : new_nodes)
+                changed_ids->push_back(node->id);
+            changed_ids->insert(changed_ids->end(), deleted_ids.begin(), deleted_ids.end());
+            for (const ConnectionChange &change : connection_changes)
+            {
+                changed_ids->push_back(change.src.node);
+                changed_ids->push_back(change.dst.node);
+            }
+            std::sort(changed_ids->begin(), changed_ids->end());
+            changed_ids->erase(std::unique(changed_ids->begin(), changed_ids->end()), changed_ids->end());
+        }
+
+        // The new ids are larger than all existing ones, so appending the new nodes keeps the list sorted.
+        circuit->nodes.reserve(circuit->nodes.size() + new_nodes.size());
+        std::move(new_nodes.begin(), new_nodes.end(), std::back_inserter(circuit->nodes));
+
+        // Apply the connection changes.
+        for (const ConnectionChange &change : connection_changes)
+        {
+            BasicNode &src_node = *circuit->FindNodeOrThrow(change.src.node);
+            BasicNode &dst_node = *circuit->FindNodeOrThrow(change.dst.node);
+            BasicNode::OutPoint &src_point = src_node.GetOutPoint(change.src.point);
+            BasicNode::InPoint &dst_point = dst_node.GetInPoint(change.dst.point);
+
+            // Remove the old connection, so that `BasicNode::Connect()` doesn't toggle its inverted-ness.
+            std::erase_if(src_point.connections, [&](const BasicNode::OutPointCon &con){return con.ids == change.dst;});
+            std::erase_if(dst_point.connections, [&](const BasicNode::InPointCon &con){return con.ids == change.src;});
+
+            if (change.connect)
+            {
+                bool is_inverted = change.is_inverted;
+                src_node.Connect(change.src.point, dst_node, change.dst.point, is_inverted);
+            }
+        }
+
+        // Remove the deleted nodes, and the connections to them.
+        if (deleted_ids.size() > 0)
+        {
+            std::sort(deleted_ids.begin(), deleted_ids.end());
+            auto NodeIdWasDeleted = [&](BasicNode::id_t id)
+            {
+                return std::binary_search(deleted_ids.begin(), deleted_ids.end(), id);
+            };
+
+            std::erase_if(circuit->nodes, [&](const NodeStorage &node){return NodeIdWasDeleted(node->id);});
+
+            for (NodeStorage &node : circuit->nodes)
+            {
+                for (int i = 0, count = node->InPointCount(); i < count; i++)
+                    std::erase_if(node->GetInPoint(i).connections, [&](const BasicNode::InPointCon &con){return NodeIdWasDeleted(con.ids.node);});
+                for (int i = 0, count = node->OutPointCount(); i < count; i++)
+                    std::erase_if(node->GetOutPoint(i).connections, [&](const BasicNode::OutPointCon &con){return NodeIdWasDeleted(con.ids.node);});
+            }
+        }
+
+        circuit->MarkModified();
+
+        first_new_id += new_nodes.size();
+        new_nodes.clear();
+        deleted_ids.clear();
+        connection_changes.clear();
+    }
+
+
+    void BasicCustomNode::Render(ivec2 offset, bool unpowered) const
+    {
+        r.iquad(pos + offset, Nodes::atlas.nodes.region(ivec2(18, 10*(Custom_IsPowered() && !unpowered)), ivec2(13,10))).center(ivec2(6,10));
 
         const CustomNodeInfo &info = Custom_GetInfo();
 
@@ -392,6 +615,10 @@ namespace Components
         r.iquad(bg_corner, bg_size).color(fvec3(0)).alpha(0.6);
         r.itext(pos + offset, info.text).color(fvec3(10,141,255)/255).align(ivec2(0,-1));
     }
+    void BasicCustomNode::RenderPoweredParts(ivec2 offset) const
+    {
+        r.iquad(pos + offset, Nodes::atlas.nodes.region(ivec2(18, 10*Custom_IsPowered()), ivec2(13,10))).center(ivec2(6,10));
+    }
     ivec2 BasicCustomNode::GetVisualHalfExtent() const
     {
         return Custom_GetInfo().text_stats.size with(x = (_.x + 1) / 2, y -= 2);
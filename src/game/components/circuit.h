@@ -2,10 +2,12 @@
 
 #include <algorithm>
 #include <cstddef>
+#include <cstdint>
 #include <limits>
 #include <memory>
 #include <vector>
 
+#include "game/components/circuit_profiler.h"
 #include "graphics/text.h"
 #include "macros/adjust.h"
 #include "macros/maybe_const.h"
@@ -33,7 +35,12 @@ namespace Components
         virtual int GetPositionInNodeList() const {return -1;} // If returns `-1`, this node will not be listed. The list will be sorted by this value (ascending).
 
         virtual void Tick(World &, const Circuit &circuit) = 0; // Should recalculate 'powered' state of connection points.
-        virtual void Render(ivec2 offset) const = 0;
+        // If `unpowered` is true, should draw the node as if none of its points were powered.
+        virtual void Render(ivec2 offset, bool unpowered) const = 0;
+        // Returns true if the node currently looks different from its unpowered look. By default checks if any of the 'out' points is powered.
+        [[nodiscard]] virtual bool LooksPowered() const;
+        // Draws the parts of the node that look different when powered, on top of the unpowered look. By default draws the whole node.
+        virtual void RenderPoweredParts(ivec2 offset) const {Render(offset, false);}
         virtual ivec2 GetVisualHalfExtent() const = 0;
 
         [[nodiscard]] bool VisuallyContainsPoint(ivec2 point, ivec2 radius = ivec2(0)) const
@@ -180,6 +187,11 @@ namespace Components
     class Circuit
     {
         std::vector<NodeStorage> copied_nodes;
+        std::uint64_t generation = NewGeneration();
+        std::uint64_t copied_generation = 0;
+
+        [[nodiscard]] static std::uint64_t NewGeneration();
+        IF_CIRCUIT_PROFILING( CircuitProfiler *profiler = nullptr; )
 
       public:
         MEMBERS(
@@ -206,9 +218,77 @@ namespace Components
             }
         )
 
+        // Changes when nodes are added or removed by `Batch::Commit()`, or when the nodes are restored by `RestoreState()`.
+        // If you add or remove nodes directly, call `MarkModified()`. The values are unique across all circuits, so assigning a different circuit changes it too.
+        // The caches compare it with the value they were built for, to notice the changes that bypassed them.
+        [[nodiscard]] std::uint64_t Generation() const {return generation;}
+        void MarkModified() {generation = NewGeneration();}
+
+        // Throws if the nodes are not sorted by id, or if some connections refer to missing nodes or points.
+        // Use this on the nodes that come from outside, since the rest of the code doesn't check this.
+        static void ValidateNodes(const std::vector<NodeStorage> &nodes);
+
         void Tick(World &world);
         void SaveState();
         void RestoreState();
+
+        // Hashes the powered state of all connection points.
+        [[nodiscard]] std::uint64_t StateHash() const;
+
+        class Batch;
+
+        IF_CIRCUIT_PROFILING(
+            // If not null, `Tick()` reports to this profiler. The profiler is not owned by the circuit.
+            void SetProfiler(CircuitProfiler *new_profiler) {profiler = new_profiler;}
+            [[nodiscard]] CircuitProfiler *GetProfiler() const {return profiler;}
+        )
+    };
+
+    // Collects node insertions, deletions and connection changes, and applies them to the circuit at once.
+    // Use this for bulk edits: the node list is modified in one pass, and the connections to the deleted nodes are removed in one more pass.
+    // Don't modify the circuit directly while a batch has pending changes, since the ids of the new nodes are assigned in advance.
+    class Circuit::Batch
+    {
+      public:
+        struct ConnectionChange
+        {
+            BasicNode::NodeAndPointId src; // An 'out' point.
+            BasicNode::NodeAndPointId dst; // An 'in' point.
+            bool is_inverted = false;
+            bool connect = true; // Otherwise disconnect.
+        };
+
+      private:
+        Circuit *circuit = nullptr;
+        BasicNode::id_t first_new_id = 0;
+        std::vector<NodeStorage> new_nodes; // Their ids are `first_new_id + i`.
+        std::vector<BasicNode::id_t> deleted_ids;
+        std::vector<ConnectionChange> connection_changes; // In the order they were requested.
+
+        [[nodiscard]] BasicNode *FindNodeIncludingNew(BasicNode::id_t id);
+
+      public:
+        Batch() {}
+        Batch(Circuit &circuit);
+
+        [[nodiscard]] bool IsEmpty() const {return new_nodes.empty() && deleted_ids.empty() && connection_changes.empty();}
+        // The id that the next added node will get.
+        [[nodiscard]] BasicNode::id_t NextNodeId() const {return first_new_id + new_nodes.size();}
+
+        // Returns the id that the node will get. The id of `node` is ignored.
+        // The connections of the node are kept as is, so they must be consistent with the other nodes after the commit.
+        BasicNode::id_t AddNode(NodeStorage node);
+        // Deleting an unknown id does nothing. All connections to the node are removed.
+        void DeleteNode(BasicNode::id_t id);
+        // The nodes can be the ones added by this batch. An existing connection between the points is replaced.
+        void Connect(BasicNode::NodeAndPointId src_out, BasicNode::NodeAndPointId dst_in, bool is_inverted);
+        // Disconnecting points that are not connected does nothing.
+        void Disconnect(BasicNode::NodeAndPointId src_out, BasicNode::NodeAndPointId dst_in);
+
+        // Applies the changes and clears the batch, which can then be reused.
+        // If `changed_ids` isn't null, the ids of all added, deleted and reconnected nodes are written to it, sorted and without duplicates.
+        // Throws if a connection change refers to a missing node or point, in that case nothing is modified.
+        void Commit(std::vector<BasicNode::id_t> *changed_ids = nullptr);
     };
 
 
@@ -238,7 +318,9 @@ namespace Components
         virtual const CustomNodeInfo &Custom_GetInfo() const = 0;
         virtual bool Custom_IsPowered() const = 0;
 
-        void Render(ivec2 offset) const override final;
+        void Render(ivec2 offset, bool unpowered) const override final;
+        bool LooksPowered() const override final {return Custom_IsPowered();}
+        void RenderPoweredParts(ivec2 offset) const override final; // Only the sprite, since the label doesn't depend on the state.
         ivec2 GetVisualHalfExtent() const override final;
 
         int GetOutPointOverlappingInPoint(int) const override final {return -1;}
@@ -0,0 +1,119 @@
+#include "circuit_file.h"
+
+#include <cstring>
+#include <exception>
+#include <vector>
+
+#include "reflection/full_with_poly.h"
+#include "stream/readonly_data.h"
+#include "utils/clock.h"
+
+namespace Components
+{
+    void CircuitFile::Save(const Circuit &circuit, Stream::Output &output, Format format)
+    {
+        switch (format)
+        {
+          case Format::binary:
+            output.WriteString(binary_magic);
+            output.WriteLittle<std::uint32_t>(current_version);
+            Refl::ToBinary(circuit, output);
+            break;
+          case Format::text:
+            Refl::ToString(circuit, output, Refl::ToStringOptions::Pretty());
+            break;
+        }
+    }
+
+    void CircuitFile::Save(const Circuit &circuit, std::string file_name, Format format)
+    {
+        Stream::Output output(file_name);
+        Save(circuit, output, format);
+        output.Flush();
+    }
+
+    Circuit CircuitFile::Load(Stream::Input &input)
+    {
+        Circuit ret;
+
+        if (input.DiscardChars<Stream::if_present>(binary_magic, std::strlen(binary_magic)))
+        {
+            std::uint32_t version = input.ReadLittle<std::uint32_t>();
+            if (version != current_version)
+                Program::Error("Unsupported circuit version ", version, ", expected ", current_version, ".");
+            Refl::FromBinary(ret, input);
+        }
+        else
+        {
+            Refl::FromString(ret, input);
+        }
+
+        // The rest of the code relies on this.
+        Circuit::ValidateNodes(ret.nodes);
+
+        return ret;
+    }
+
+    Circuit CircuitFile::Load(std::string file_name)
+    {
+        try
+        {
+            Stream::Input input(file_name);
+            return Load(input);
+        }
+        catch (std::exception &e)
+        {
+            Program::Error("While loading circuit `", file_name, "`:\n", e.what());
+        }
+    }
+
+    CircuitFile::BenchmarkResult CircuitFile::Benchmark(const Circuit &circuit, int iterations)
+    {
+        BenchmarkResult ret;
+
+        // Returns megabytes per second.
+        auto Measure = [&](std::size_t bytes, auto &&func)
+        {
+            std::uint64_t start = Clock::Time();
+            for (int i = 0; i < iterations; i++)
+                func();
+            double seconds = Clock::TicksToSeconds(Clock::Time() - start);
+            return bytes * double(iterations) / (1024 * 1024) / seconds;
+        };
+
+        for (Format format : {Format::binary, Format::text})
+        {
+            std::vector<unsigned char> buffer;
+            auto SaveToBuffer = [&]
+            {
+                buffer.clear();
+                auto output = Stream::Output::Container(buffer);
+                Save(circuit, output, format);
+                output.Flush();
+            };
+            SaveToBuffer(); // Also warms up the allocations.
+
+            double save_speed = Measure(buffer.size(), SaveToBuffer);
+            double load_speed = Measure(buffer.size(), [&]
+            {
+                Stream::Input input(Stream::ReadOnlyData::mem_reference(buffer));
+                (void)Load(input);
+            });
+
+            if (format == Format::binary)
+            {
+                ret.binary_size = buffer.size();
+                ret.binary_save_mb_per_sec = save_speed;
+                ret.binary_load_mb_per_sec = load_speed;
+            }
+            else
+            {
+                ret.text_size = buffer.size();
+                ret.text_save_mb_per_sec = save_speed;
+                ret.text_load_mb_per_sec = load_speed;
+            }
+        }
+
+        return ret;
+    }
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+#include "game/components/circuit.h"
+#include "stream/input.h"
+#include "stream/output.h"
+
+namespace Components
+{
+    // Saving and loading circuits.
+    // The binary format is the default: a magic string, a little-endian 32-bit version, then the circuit serialized with `Refl::ToBinary()`.
+    // The text format is the circuit serialized with `Refl::ToString()`, it's only meant for exporting and for the old saves.
+    class CircuitFile
+    {
+      public:
+        enum class Format {binary, text};
+
+        static constexpr std::uint32_t current_version = 1;
+        static constexpr char binary_magic[] = "CBCIRCT\n"; // The null-terminator is not written.
+
+        struct BenchmarkResult
+        {
+            std::size_t binary_size = 0, text_size = 0; // In bytes.
+            double binary_save_mb_per_sec = 0, binary_load_mb_per_sec = 0;
+            double text_save_mb_per_sec = 0, text_load_mb_per_sec = 0;
+        };
+
+        static void Save(const Circuit &circuit, Stream::Output &output, Format format = Format::binary);
+        static void Save(const Circuit &circuit, std::string file_name, Format format = Format::binary);
+
+        // Detects the format automatically. Throws on failure.
+        [[nodiscard]] static Circuit Load(Stream::Input &input);
+        [[nodiscard]] static Circuit Load(std::string file_name);
+
+        // Saves and loads the circuit in memory in both formats, `iterations` times each, and measures the throughput.
+        [[nodiscard]] static BenchmarkResult Benchmark(const Circuit &circuit, int iterations);
+    };
+}
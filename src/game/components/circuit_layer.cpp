@@ -0,0 +1,346 @@
+#include "circuit_layer.h"
+
+#include <cstdint>
+#include <iterator>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+#include "game/main.h"
+#include "graphics/complete.h"
+#include "macros/finally.h"
+#include "reflection/full.h"
+
+namespace Components
+{
+    static_assert(CircuitLayer::tile_size <= screen_size.min());
+
+    struct CircuitLayer::Data
+    {
+        SIMPLE_STRUCT( ShaderAttribs
+            DECL(fvec2) pos
+        )
+
+        SIMPLE_STRUCT( ShaderUniforms
+            DECL(Graphics::Uniform<fmat4> ATTR Graphics::Vert) matrix
+            DECL(Graphics::Uniform<Graphics::TexUnit> ATTR Graphics::Frag) texture
+        )
+
+        static constexpr const char *shader_vert_src = R"(
+varying vec2 v_texcoord;
+void main()
+{
+    v_texcoord = vec2(a_pos.x, 1.0 - a_pos.y);
+    gl_Position = u_matrix * vec4(a_pos, 0, 1);
+})";
+        // The tiles are already premultiplied, so unlike the main shader we don't multiply the color by alpha.
+        static constexpr const char *shader_frag_src = R"(
+varying vec2 v_texcoord;
+void main()
+{
+    gl_FragColor = texture2D(u_texture, v_texcoord);
+})";
+
+        static constexpr int node_margin = 4; // Some nodes draw slightly outside of their visual half-extent.
+        static constexpr int connection_margin = 8; // Enough for the decorations at the ends of connections.
+
+        struct Tile
+        {
+            Graphics::TexObject texture;
+            Graphics::FrameBuffer framebuffer;
+            bool dirty = true;
+            std::uint64_t last_used_frame = 0;
+        };
+
+        struct Area
+        {
+            ivec2 a, b; // Inclusive, in circuit coordinates.
+        };
+
+        Graphics::Shader shader;
+        ShaderUniforms shader_uni;
+        Graphics::TexUnit tex_unit;
+        Graphics::VertexBuffer<ShaderAttribs> vertex_buf;
+
+        std::unordered_map<std::uint64_t, Tile> tiles;
+        std::uint64_t frame = 0;
+
+        std::unordered_map<BasicNode::id_t, Area> node_areas; // The areas covered by each node and its connections, as they were last rendered.
+        std::unordered_set<BasicNode::id_t> dirty_nodes;
+
+        // `Circuit::Generation()` as of the last sync, used to detect circuit changes that bypassed `MarkNodeDirty()`.
+        std::uint64_t synced_generation = 0;
+
+        Data()
+        {
+            shader = Graphics::Shader("Circuit layer", Graphics::ShaderConfig::Core(), Graphics::ShaderPreferences{}, Meta::tag<ShaderAttribs>{}, shader_uni, shader_vert_src, shader_frag_src);
+            tex_unit = nullptr;
+            shader_uni.texture = tex_unit;
+
+            ShaderAttribs vertex_data[]
+            {
+                {fvec2(0,0)}, {fvec2(1,0)}, {fvec2(1,1)},
+                {fvec2(0,0)}, {fvec2(1,1)}, {fvec2(0,1)},
+            };
+            vertex_buf = Graphics::VertexBuffer<ShaderAttribs>(std::size(vertex_data), vertex_data);
+        }
+
+        [[nodiscard]] static std::uint64_t TileKey(ivec2 tile)
+        {
+            return std::uint64_t(std::uint32_t(tile.x)) << 32 | std::uint32_t(tile.y);
+        }
+
+        [[nodiscard]] static Area CalcNodeArea(const Circuit &circuit, const BasicNode &node)
+        {
+            Area ret;
+            ret.a = node.pos - node.GetVisualHalfExtent() - node_margin;
+            ret.b = node.pos + node.GetVisualHalfExtent() + node_margin;
+
+            auto AddSegment = [&](ivec2 p1, ivec2 p2)
+            {
+                ret.a = min(ret.a, p1 - connection_margin, p2 - connection_margin);
+                ret.b = max(ret.b, p1 + connection_margin, p2 + connection_margin);
+            };
+
+            for (int i = 0, count = node.InPointCount(); i < count; i++)
+            {
+                const BasicNode::InPoint &point = node.GetInPoint(i);
+                for (const BasicNode::InPointCon &con : point.connections)
+                {
+                    if (const NodeStorage *other = circuit.FindNodeIfExists(con.ids.node); other && con.ids.point < (*other)->OutPointCount())
+                        AddSegment(node.pos + point.info->offset_to_node, (*other)->pos + (*other)->GetOutPoint(con.ids.point).info->offset_to_node);
+                }
+            }
+            for (int i = 0, count = node.OutPointCount(); i < count; i++)
+            {
+                const BasicNode::OutPoint &point = node.GetOutPoint(i);
+                for (const BasicNode::OutPointCon &con : point.connections)
+                {
+                    if (const NodeStorage *other = circuit.FindNodeIfExists(con.ids.node); other && con.ids.point < (*other)->InPointCount())
+                        AddSegment(node.pos + point.info->offset_to_node, (*other)->pos + (*other)->GetInPoint(con.ids.point).info->offset_to_node);
+                }
+            }
+
+            return ret;
+        }
+
+        void MarkAreaDirty(Area area)
+        {
+            ivec2 tile_a = div_ex(area.a, tile_size), tile_b = div_ex(area.b, tile_size);
+            for (ivec2 tile = tile_a; tile.y <= tile_b.y; tile.y++)
+            for (tile.x = tile_a.x; tile.x <= tile_b.x; tile.x++)
+            {
+                auto it = tiles.find(TileKey(tile));
+                if (it != tiles.end())
+                    it->second.dirty = true;
+            }
+        }
+
+        void RememberCircuitGeneration(const Circuit &circuit)
+        {
+            synced_generation = circuit.Generation();
+        }
+
+        void ApplyNodeChanges(const Circuit &circuit)
+        {
+            if (dirty_nodes.empty())
+            {
+                if (circuit.Generation() != synced_generation)
+                {
+                    // The circuit was replaced, start from scratch.
+                    for (auto &[key, tile] : tiles)
+                        tile.dirty = true;
+                    node_areas.clear();
+                    for (const NodeStorage &node : circuit.nodes)
+                        node_areas[node->id] = CalcNodeArea(circuit, *node);
+                    RememberCircuitGeneration(circuit);
+                }
+                return;
+            }
+
+            // The areas of the neighbors depend on the positions of the dirty nodes, so they're recalculated too.
+            // The neighbors themselves don't need to be redrawn, since the shared connections are in the areas of the dirty nodes.
+            std::vector<BasicNode::id_t> neighbors;
+
+            for (BasicNode::id_t id : dirty_nodes)
+            {
+                // Redraw the old area.
+                if (auto it = node_areas.find(id); it != node_areas.end())
+                {
+                    MarkAreaDirty(it->second);
+                    node_areas.erase(it);
+                }
+
+                // Redraw the new area.
+                const NodeStorage *node = circuit.FindNodeIfExists(id);
+                if (!node)
+                    continue;
+                Area area = CalcNodeArea(circuit, **node);
+                node_areas[id] = area;
+                MarkAreaDirty(area);
+
+                for (int i = 0, count = (*node)->InPointCount(); i < count; i++)
+                {
+                    for (const BasicNode::InPointCon &con : (*node)->GetInPoint(i).connections)
+                        neighbors.push_back(con.ids.node);
+                }
+                for (int i = 0, count = (*node)->OutPointCount(); i < count; i++)
+                {
+                    for (const BasicNode::OutPointCon &con : (*node)->GetOutPoint(i).connections)
+                        neighbors.push_back(con.ids.node);
+                }
+            }
+
+            for (BasicNode::id_t id : neighbors)
+            {
+                if (dirty_nodes.contains(id))
+                    continue;
+                if (const NodeStorage *node = circuit.FindNodeIfExists(id))
+                    node_areas[id] = CalcNodeArea(circuit, **node);
+            }
+
+            dirty_nodes.clear();
+            RememberCircuitGeneration(circuit);
+        }
+
+        // Returns the tile, creating it if necessary. New tiles are dirty.
+        Tile &GetTile(ivec2 tile_pos)
+        {
+            std::uint64_t key = TileKey(tile_pos);
+            if (auto it = tiles.find(key); it != tiles.end())
+                return it->second;
+
+            if (tiles.size() >= std::size_t(max_tiles))
+            {
+                // Reuse the tile that wasn't visible for the longest time.
+                auto oldest = tiles.end();
+                for (auto it = tiles.begin(); it != tiles.end(); it++)
+                {
+                    if (it->second.last_used_frame < frame && (oldest == tiles.end() || it->second.last_used_frame < oldest->second.last_used_frame))
+                        oldest = it;
+                }
+
+                if (oldest != tiles.end())
+                {
+                    auto node = tiles.extract(oldest);
+                    node.key() = key;
+                    node.mapped().dirty = true;
+                    return tiles.insert(std::move(node)).position->second;
+                }
+            }
+
+            Tile &tile = tiles[key];
+            tile.texture = nullptr;
+            tex_unit.Attach(tile.texture).Wrap(Graphics::clamp).Interpolation(Graphics::nearest).SetData(ivec2(tile_size));
+            tile.framebuffer = Graphics::FrameBuffer(nullptr).Attach(tile.texture);
+            return tile;
+        }
+
+        // The framebuffer, the viewport, and the matrix of `r` must be already set up.
+        void RenderTile(const Circuit &circuit, const NodeGrid &node_grid, const EdgeGrid &edge_grid, ivec2 tile_pos, Tile &tile)
+        {
+            tile.framebuffer.Bind();
+            Graphics::Clear();
+
+            ivec2 a = tile_pos * tile_size;
+            ivec2 b = a + tile_size - 1;
+            ivec2 center = a + tile_size / 2;
+
+            for (BasicNode::id_t id : node_grid.QueryRect(a - node_margin, b + node_margin))
+            {
+                if (const NodeStorage *node = circuit.FindNodeIfExists(id))
+                    (*node)->Render(-center, true);
+            }
+
+            for (const EdgeGrid::Edge *edge : edge_grid.QueryRect(a - connection_margin, b + connection_margin))
+            {
+                std::optional<EdgeGrid::ResolvedEdge> e = EdgeGrid::Resolve(circuit, *edge);
+                if (!e)
+                    continue;
+
+                // Since the source is unpowered, only the inverted connections are powered.
+                BasicNode::DrawConnection(ivec2(0), e->src_node->pos + e->src_point->info->offset_to_node - center, e->dst_node->pos + e->dst_point->info->offset_to_node - center,
+                    e->is_inverted, e->is_inverted, e->src_point->info->visual_radius + e->src_point->info->extra_out_visual_radius, e->dst_point->info->visual_radius);
+            }
+
+            r.Finish();
+            tile.dirty = false;
+        }
+    };
+
+    CircuitLayer::CircuitLayer() {}
+    CircuitLayer::CircuitLayer(CircuitLayer &&) noexcept = default;
+    CircuitLayer &CircuitLayer::operator=(CircuitLayer &&) noexcept = default;
+    CircuitLayer::~CircuitLayer() = default;
+
+    void CircuitLayer::MarkNodeDirty(BasicNode::id_t id)
+    {
+        if (data)
+            data->dirty_nodes.insert(id);
+    }
+
+    void CircuitLayer::Update(const Circuit &circuit, const NodeGrid &node_grid, const EdgeGrid &edge_grid, ivec2 a, ivec2 b)
+    {
+        if (!data)
+            data = std::make_unique<Data>(); // The new layer notices that the circuit has changed, and calculates everything from scratch.
+        Data &d = *data;
+
+        d.frame++;
+        d.ApplyNodeChanges(circuit);
+
+        std::vector<std::pair<ivec2, Data::Tile *>> outdated_tiles;
+
+        ivec2 tile_a = div_ex(a, tile_size), tile_b = div_ex(b, tile_size);
+        for (ivec2 tile_pos = tile_a; tile_pos.y <= tile_b.y; tile_pos.y++)
+        for (tile_pos.x = tile_a.x; tile_pos.x <= tile_b.x; tile_pos.x++)
+        {
+            Data::Tile &tile = d.GetTile(tile_pos);
+            tile.last_used_frame = d.frame;
+            if (tile.dirty)
+                outdated_tiles.emplace_back(tile_pos, &tile);
+        }
+
+        if (outdated_tiles.empty())
+            return;
+
+        r.Finish();
+        FINALLY(
+            r.SetMatrix(adaptive_viewport.GetDetails().MatrixCentered());
+            adaptive_viewport.BeginFrame();
+        )
+        r.SetMatrix(fmat4::ortho(ivec2(-tile_size/2, tile_size/2), ivec2(tile_size/2, -tile_size/2), -1, 1));
+        Graphics::Viewport(ivec2(tile_size));
+        Graphics::SetClearColor(fvec4(0));
+
+        for (auto [tile_pos, tile] : outdated_tiles)
+            d.RenderTile(circuit, node_grid, edge_grid, tile_pos, *tile);
+    }
+
+    void CircuitLayer::Render(ivec2 a, ivec2 b, ivec2 offset) const
+    {
+        if (!data)
+            return;
+        Data &d = *data;
+
+        r.Finish();
+        FINALLY( r.BindShader(); )
+        d.shader.Bind();
+
+        fmat4 screen_matrix = adaptive_viewport.GetDetails().MatrixCentered();
+
+        ivec2 tile_a = div_ex(a, tile_size), tile_b = div_ex(b, tile_size);
+        for (ivec2 tile_pos = tile_a; tile_pos.y <= tile_b.y; tile_pos.y++)
+        for (tile_pos.x = tile_a.x; tile_pos.x <= tile_b.x; tile_pos.x++)
+        {
+            auto it = d.tiles.find(Data::TileKey(tile_pos));
+            if (it == d.tiles.end() || it->second.dirty)
+                continue;
+
+            fvec2 screen_pos(tile_pos * tile_size + offset);
+            d.shader_uni.matrix = screen_matrix * fmat4::translate(screen_pos.to_vec3(0)) * fmat4::scale(fvec3(tile_size, tile_size, 1));
+            d.tex_unit.Attach(it->second.texture);
+            d.vertex_buf.Draw(Graphics::triangles);
+        }
+    }
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <memory>
+
+#include "game/components/circuit.h"
+#include "game/components/edge_grid.h"
+#include "game/components/node_grid.h"
+#include "utils/mat.h"
+
+namespace Components
+{
+    // Caches the unpowered look of the circuit (node sprites and connections) in textures, split into square tiles.
+    // A tile is only rendered when it becomes visible, or when it's visible and was touched by an edit.
+    // The powered parts of the circuit must be drawn on top of it every frame, see `BasicNode::LooksPowered()` and `BasicNode::RenderPoweredParts()`.
+    //
+    // Call `MarkNodeDirty()` for every node that was moved, created, deleted, connected or disconnected.
+    // Before rendering, call `Update()` (outside of any scissor box), then `Render()`.
+    class CircuitLayer
+    {
+        struct Data;
+        std::unique_ptr<Data> data; // Created by the first `Update()`.
+
+      public:
+        // Can't be larger than the screen, because `BasicNode::DrawConnection()` culls connections against the screen size.
+        static constexpr int tile_size = 256;
+        // This many tiles are kept in memory, the ones that weren't visible for the longest time are discarded first.
+        static constexpr int max_tiles = 48;
+
+        CircuitLayer();
+        CircuitLayer(CircuitLayer &&) noexcept;
+        CircuitLayer &operator=(CircuitLayer &&) noexcept;
+        ~CircuitLayer();
+
+        void MarkNodeDirty(BasicNode::id_t id);
+
+        // Applies the node changes, and renders the missing or outdated tiles intersecting the rectangle (circuit coordinates, inclusive).
+        // The grids must be up to date. Uses `r`, and binds the main framebuffer afterwards.
+        void Update(const Circuit &circuit, const NodeGrid &node_grid, const EdgeGrid &edge_grid, ivec2 a, ivec2 b);
+        // Draws the tiles intersecting the rectangle (circuit coordinates, inclusive). `offset` converts circuit coordinates to screen coordinates.
+        void Render(ivec2 a, ivec2 b, ivec2 offset) const;
+    };
+}
@@ -0,0 +1,124 @@
+#include "circuit_lod.h"
+
+#include <algorithm>
+#include <utility>
+
+namespace Components
+{
+    void CircuitLod::RebuildQuadtree(const Circuit &circuit)
+    {
+        quad_nodes.clear();
+        if (circuit.nodes.empty())
+            return;
+
+        // Find the smallest aligned square containing all nodes.
+        ivec2 bounds_a = circuit.nodes.front()->pos, bounds_b = bounds_a;
+        for (const NodeStorage &node : circuit.nodes)
+        {
+            bounds_a = min(bounds_a, node->pos);
+            bounds_b = max(bounds_b, node->pos);
+        }
+        root_size = min_cell_size;
+        while (true)
+        {
+            root_pos = div_ex(bounds_a, root_size) * root_size;
+            if ((root_pos + root_size > bounds_b).all())
+                break;
+            root_size *= 2;
+        }
+
+        quad_nodes.emplace_back();
+        for (const NodeStorage &node : circuit.nodes)
+        {
+            std::uint32_t index = 0;
+            ivec2 pos = root_pos;
+            int size = root_size;
+            while (true)
+            {
+                quad_nodes[index].count++;
+                if (size == min_cell_size)
+                    break;
+
+                size /= 2;
+                ivec2 half = ivec2(node->pos >= pos + size);
+                pos += half * size;
+
+                std::uint32_t &child = quad_nodes[index].children[half.x + half.y * 2];
+                if (!child)
+                {
+                    child = quad_nodes.size();
+                    quad_nodes.emplace_back(); // Note that this invalidates `child`.
+                }
+                index = quad_nodes[index].children[half.x + half.y * 2];
+            }
+        }
+    }
+
+    void CircuitLod::RebuildBundles(const Circuit &circuit)
+    {
+        bundles.clear();
+
+        auto CellToKey = [](ivec2 cell) {return std::uint64_t(std::uint32_t(cell.x)) << 32 | std::uint32_t(cell.y);};
+        auto KeyToCell = [](std::uint64_t key) {return ivec2(std::int32_t(key >> 32), std::int32_t(key & 0xffffffff));};
+
+        // Pairs of cells, one per connection. The direction doesn't matter, so the cells in each pair are sorted.
+        std::vector<std::pair<std::uint64_t, std::uint64_t>> links;
+
+        for (const NodeStorage &dst_node : circuit.nodes)
+        {
+            ivec2 dst_cell = div_ex(dst_node->pos, bundle_cell_size);
+
+            for (int i = 0, count = dst_node->InPointCount(); i < count; i++)
+            {
+                for (const BasicNode::InPointCon &con : dst_node->GetInPoint(i).connections)
+                {
+                    const NodeStorage *src_node = circuit.FindNodeIfExists(con.ids.node);
+                    if (!src_node)
+                        continue;
+
+                    ivec2 src_cell = div_ex((*src_node)->pos, bundle_cell_size);
+                    if (src_cell == dst_cell)
+                        continue; // The connections inside of a cell are omitted.
+
+                    links.push_back(std::minmax(CellToKey(src_cell), CellToKey(dst_cell)));
+                }
+            }
+        }
+
+        // Merge the identical pairs.
+        std::sort(links.begin(), links.end());
+        for (std::size_t i = 0; i < links.size();)
+        {
+            std::size_t j = i + 1;
+            while (j < links.size() && links[j] == links[i])
+                j++;
+
+            bundles.push_back({
+                .a = KeyToCell(links[i].first) * bundle_cell_size + bundle_cell_size / 2,
+                .b = KeyToCell(links[i].second) * bundle_cell_size + bundle_cell_size / 2,
+                .count = std::uint32_t(j - i),
+            });
+            i = j;
+        }
+    }
+
+    void CircuitLod::Update(const Circuit &circuit, int new_bundle_cell_size)
+    {
+        DebugAssert("Bad LOD cell size.", new_bundle_cell_size >= min_cell_size && (new_bundle_cell_size & (new_bundle_cell_size - 1)) == 0);
+
+        if (dirty || circuit.Generation() != synced_generation)
+        {
+            RebuildQuadtree(circuit);
+            bundle_cell_size = 0; // Force the bundles to be rebuilt.
+
+            dirty = false;
+            synced_generation = circuit.Generation();
+        }
+
+        if (bundle_cell_size != new_bundle_cell_size)
+        {
+            bundle_cell_size = new_bundle_cell_size;
+            RebuildBundles(circuit);
+        }
+    }
+}
@@ -0,0 +1,104 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "game/components/circuit.h"
+#include "program/errors.h"
+#include "utils/mat.h"
+
+namespace Components
+{
+    // A level-of-detail representation of the circuit, for the zoomed out editor view.
+    // The node counts are stored in a quadtree, so the occupied cells of any size can be listed without visiting the empty space.
+    // The connections are bundled: all connections between the same two cells are merged into one, and the connections inside of a cell are omitted.
+    // The LOD is rebuilt from scratch by `Update()` after `MarkDirty()` is called, so it's only suitable for the views where the circuit can't be edited.
+    class CircuitLod
+    {
+      public:
+        static constexpr int min_cell_size = 2; // The size of the quadtree leaves.
+
+        struct Bundle
+        {
+            ivec2 a{}, b{}; // The centers of the two cells.
+            std::uint32_t count = 0; // The amount of connections in the bundle.
+        };
+
+      private:
+        struct QuadNode
+        {
+            std::uint32_t count = 0; // The amount of circuit nodes in this cell.
+            std::uint32_t children[4] {}; // Zero means no child, since the root can't be a child. The index is `x + y*2`.
+        };
+
+        std::vector<QuadNode> quad_nodes; // The first element is the root. Empty if there are no circuit nodes.
+        ivec2 root_pos{}; // A multiple of `root_size`, so the cells of every size are aligned to the multiples of their size.
+        int root_size = min_cell_size;
+
+        std::vector<Bundle> bundles;
+        int bundle_cell_size = 0;
+
+        bool dirty = true;
+
+        // `Circuit::Generation()` as of the last sync, used to detect circuit changes that bypassed `MarkDirty()`.
+        std::uint64_t synced_generation = 0;
+
+        void RebuildQuadtree(const Circuit &circuit);
+        void RebuildBundles(const Circuit &circuit);
+
+        template <typename F>
+        void ForEachCellLow(std::uint32_t index, ivec2 pos, int size, ivec2 a, ivec2 b, int cell_size, F &func) const
+        {
+            if ((pos > b).any() || (pos + size <= a).any())
+                return;
+
+            const QuadNode &node = quad_nodes[index];
+            if (size == cell_size)
+            {
+                func(pos, node.count);
+                return;
+            }
+
+            int half_size = size / 2;
+            for (int i = 0; i < 4; i++)
+            {
+                if (node.children[i])
+                    ForEachCellLow(node.children[i], pos + ivec2(i % 2, i / 2) * half_size, half_size, a, b, cell_size, func);
+            }
+        }
+
+      public:
+        CircuitLod() {}
+
+        void MarkDirty() {dirty = true;}
+
+        // Rebuilds the LOD if it was marked as dirty, or if the circuit was obviously changed.
+        // `new_bundle_cell_size` must be a power of two, at least `min_cell_size`.
+        void Update(const Circuit &circuit, int new_bundle_cell_size);
+
+        // Calls `func(ivec2 cell_pos, std::uint32_t node_count)` for each non-empty cell intersecting the rectangle (inclusive).
+        // `cell_size` must be a power of two, at least `min_cell_size`. `cell_pos` is the top-left corner of the cell.
+        template <typename F>
+        void ForEachCell(ivec2 a, ivec2 b, int cell_size, F &&func) const
+        {
+            DebugAssert("Bad LOD cell size.", cell_size >= min_cell_size && (cell_size & (cell_size - 1)) == 0);
+            if (quad_nodes.empty())
+                return;
+
+            if (cell_size > root_size)
+            {
+                // The whole circuit fits into one cell.
+                ivec2 cell_pos = div_ex(root_pos, cell_size) * cell_size;
+                if ((cell_pos <= b).all() && (cell_pos + cell_size > a).all())
+                    func(cell_pos, quad_nodes.front().count);
+                return;
+            }
+
+            ForEachCellLow(0, root_pos, root_size, a, b, cell_size, func);
+        }
+
+        // The connection bundles for the cell size passed to the last `Update()`.
+        [[nodiscard]] const std::vector<Bundle> &GetBundles() const {return bundles;}
+    };
+}
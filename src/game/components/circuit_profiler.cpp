@@ -0,0 +1,85 @@
+#include "circuit_profiler.h"
+
+#include <algorithm>
+
+#include "game/components/circuit.h"
+#include "utils/clock.h"
+
+namespace Components
+{
+    void CircuitProfiler::Reset()
+    {
+        nodes.clear();
+        ticks_in_window = 0;
+        report = {};
+        current_node = nullptr;
+    }
+
+    void CircuitProfiler::BeginNode(const BasicNode &node)
+    {
+        NodeEntry &entry = nodes[node.id];
+
+        // The name is only recomputed when the node id is reused for a different node type, since `GetName()` allocates.
+        std::type_index type = typeid(node);
+        if (entry.type != type)
+        {
+            entry.type = type;
+            entry.name = node.GetName();
+            entry.counters = {};
+        }
+
+        entry.counters.evaluations++;
+        current_node = &entry;
+        current_node_start_time = Clock::Time();
+    }
+
+    void CircuitProfiler::EndNode()
+    {
+        if (!current_node)
+            return;
+        current_node->counters.seconds += Clock::TicksToSeconds(Clock::Time() - current_node_start_time);
+        current_node = nullptr;
+    }
+
+    void CircuitProfiler::EndTick()
+    {
+        if (++ticks_in_window < window_ticks)
+            return;
+
+        auto ByTimeDescending = [](const NamedCounters &a, const NamedCounters &b){return a.counters.seconds > b.counters.seconds;};
+
+        Report new_report;
+
+        std::unordered_map<std::type_index, std::size_t> type_indices;
+        for (auto &[id, entry] : nodes)
+        {
+            Counters counters = entry.counters;
+            counters.evaluations /= window_ticks;
+            counters.connection_reads /= window_ticks;
+            counters.seconds /= window_ticks;
+
+            new_report.total += counters;
+
+            auto [it, is_new] = type_indices.try_emplace(entry.type, new_report.node_types.size());
+            if (is_new)
+                new_report.node_types.push_back({entry.name, {}});
+            new_report.node_types[it->second].counters += counters;
+
+            new_report.hottest_nodes.push_back({Str(entry.name, " #", id), counters});
+        }
+
+        std::sort(new_report.node_types.begin(), new_report.node_types.end(), ByTimeDescending);
+
+        std::size_t top_count = std::min(new_report.hottest_nodes.size(), std::size_t(top_node_count));
+        std::partial_sort(new_report.hottest_nodes.begin(), new_report.hottest_nodes.begin() + top_count, new_report.hottest_nodes.end(), ByTimeDescending);
+        new_report.hottest_nodes.resize(top_count);
+
+        report = std::move(new_report);
+
+        // Forget the nodes that weren't evaluated in this window (most likely they were deleted).
+        std::erase_if(nodes, [](const auto &pair){return pair.second.counters.evaluations == 0;});
+        for (auto &[id, entry] : nodes)
+            entry.counters = {};
+        ticks_in_window = 0;
+    }
+}
@@ -0,0 +1,91 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <typeindex>
+#include <unordered_map>
+#include <vector>
+
+// Define `CIRCUIT_PROFILING` to collect per-node statistics in `Circuit::Tick()`.
+// Otherwise `CircuitProfiler` is never used, and the hooks in the circuit compile to nothing.
+#ifdef CIRCUIT_PROFILING
+#  define IF_CIRCUIT_PROFILING(...) __VA_ARGS__
+#else
+#  define IF_CIRCUIT_PROFILING(...)
+#endif
+
+namespace Components
+{
+    class BasicNode;
+
+    // Collects the amount of node evaluations, connection reads, and time spent, per node type and per node.
+    // The values are accumulated over `window_ticks` ticks, and then averaged per tick.
+    class CircuitProfiler
+    {
+      public:
+        static constexpr int window_ticks = 60, top_node_count = 10;
+
+        struct Counters
+        {
+            double evaluations = 0;
+            double connection_reads = 0;
+            double seconds = 0;
+
+            Counters &operator+=(const Counters &other)
+            {
+                evaluations += other.evaluations;
+                connection_reads += other.connection_reads;
+                seconds += other.seconds;
+                return *this;
+            }
+        };
+
+        struct NamedCounters
+        {
+            std::string name;
+            Counters counters;
+        };
+
+        // Averages over the last complete window.
+        struct Report
+        {
+            Counters total;
+            std::vector<NamedCounters> node_types; // Sorted by time, descending.
+            std::vector<NamedCounters> hottest_nodes; // At most `top_node_count` elements, sorted by time, descending.
+        };
+
+      private:
+        struct NodeEntry
+        {
+            std::type_index type = typeid(void);
+            std::string name;
+            Counters counters;
+        };
+
+        std::unordered_map<unsigned int, NodeEntry> nodes; // Keyed by node id.
+        int ticks_in_window = 0;
+        Report report;
+
+        NodeEntry *current_node = nullptr;
+        std::uint64_t current_node_start_time = 0;
+
+      public:
+        CircuitProfiler() {}
+
+        [[nodiscard]] const Report &GetReport() const {return report;}
+
+        // Discards all collected data, including the last report.
+        void Reset();
+
+        void BeginNode(const BasicNode &node);
+        void EndNode();
+        void EndTick();
+
+        void AddConnectionRead()
+        {
+            if (current_node)
+                current_node->counters.connection_reads++;
+        }
+    };
+}
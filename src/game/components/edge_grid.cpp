@@ -0,0 +1,261 @@
+#include "edge_grid.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace Components
+{
+    std::uint64_t EdgeGrid::CellKey(ivec2 cell)
+    {
+        return std::uint64_t(std::uint32_t(cell.x)) << 32 | std::uint32_t(cell.y);
+    }
+
+    ivec2 EdgeGrid::PixelToCell(ivec2 pixel)
+    {
+        return div_ex(pixel, cell_size);
+    }
+
+    template <typename F>
+    void EdgeGrid::ForEachCellOnSegment(ivec2 a, ivec2 b, F &&func)
+    {
+        // This is the usual grid traversal (Amanatides & Woo), over the pixel centers.
+        ivec2 cell = PixelToCell(a), end_cell = PixelToCell(b);
+        func(cell);
+
+        fvec2 start = a + 0.5f;
+        fvec2 dir = b - a;
+        ivec2 step = sign(b - a);
+
+        fvec2 t_max, t_delta;
+        for (int i = 0; i < 2; i++)
+        {
+            if (step[i] == 0)
+            {
+                t_max[i] = t_delta[i] = std::numeric_limits<float>::infinity();
+                continue;
+            }
+            float boundary = (cell[i] + (step[i] > 0)) * cell_size;
+            t_max[i] = (boundary - start[i]) / dir[i];
+            t_delta[i] = cell_size / std::abs(dir[i]);
+        }
+
+        // The step count is known in advance, this protects us from rounding errors.
+        int steps = abs(end_cell.x - cell.x) + abs(end_cell.y - cell.y);
+        while (steps-- > 0)
+        {
+            int axis = t_max.x < t_max.y ? 0 : 1;
+            cell[axis] += step[axis];
+            t_max[axis] += t_delta[axis];
+            func(cell);
+        }
+    }
+
+    void EdgeGrid::AddEdge(const Edge &edge)
+    {
+        std::uint32_t slot;
+        if (free_slots.empty())
+        {
+            slot = edges.size();
+            edges.push_back(edge);
+        }
+        else
+        {
+            slot = free_slots.back();
+            free_slots.pop_back();
+            edges[slot] = edge;
+        }
+
+        node_edges[edge.src_node].push_back(slot);
+        if (edge.dst_node != edge.src_node)
+            node_edges[edge.dst_node].push_back(slot);
+
+        ForEachCellOnSegment(edge.pos_src, edge.pos_dst, [&](ivec2 cell){cells[CellKey(cell)].push_back(slot);});
+    }
+
+    void EdgeGrid::RemoveEdge(std::uint32_t slot)
+    {
+        const Edge &edge = edges[slot];
+
+        ForEachCellOnSegment(edge.pos_src, edge.pos_dst, [&](ivec2 cell)
+        {
+            auto it = cells.find(CellKey(cell));
+            if (it == cells.end())
+                return;
+            std::erase(it->second, slot);
+            if (it->second.empty())
+                cells.erase(it);
+        });
+
+        for (BasicNode::id_t id : {edge.src_node, edge.dst_node})
+        {
+            auto it = node_edges.find(id);
+            if (it == node_edges.end())
+                continue;
+            std::erase(it->second, slot);
+            if (it->second.empty())
+                node_edges.erase(it);
+        }
+
+        free_slots.push_back(slot);
+    }
+
+    void EdgeGrid::AddNodeInEdges(const Circuit &circuit, const BasicNode &node)
+    {
+        for (int i = 0, count = node.InPointCount(); i < count; i++)
+        {
+            const BasicNode::InPoint &dst_point = node.GetInPoint(i);
+            for (const BasicNode::InPointCon &con : dst_point.connections)
+            {
+                const NodeStorage *src_node = circuit.FindNodeIfExists(con.ids.node);
+                if (!src_node || con.ids.point >= (*src_node)->OutPointCount())
+                    continue;
+
+                AddEdge({
+                    .src_node = con.ids.node,
+                    .src_point = con.ids.point,
+                    .dst_node = node.id,
+                    .dst_point = i,
+                    .pos_src = (*src_node)->pos + (*src_node)->GetOutPoint(con.ids.point).info->offset_to_node,
+                    .pos_dst = node.pos + dst_point.info->offset_to_node,
+                });
+            }
+        }
+    }
+
+    void EdgeGrid::AddNodeEdges(const Circuit &circuit, const BasicNode &node)
+    {
+        AddNodeInEdges(circuit, node);
+
+        for (int i = 0, count = node.OutPointCount(); i < count; i++)
+        {
+            const BasicNode::OutPoint &src_point = node.GetOutPoint(i);
+            for (const BasicNode::OutPointCon &con : src_point.connections)
+            {
+                // If the other node is dirty too, it adds this edge as its 'in' connection.
+                if (dirty_nodes.contains(con.ids.node))
+                    continue;
+
+                const NodeStorage *dst_node = circuit.FindNodeIfExists(con.ids.node);
+                if (!dst_node || con.ids.point >= (*dst_node)->InPointCount())
+                    continue;
+
+                AddEdge({
+                    .src_node = node.id,
+                    .src_point = i,
+                    .dst_node = con.ids.node,
+                    .dst_point = con.ids.point,
+                    .pos_src = node.pos + src_point.info->offset_to_node,
+                    .pos_dst = (*dst_node)->pos + (*dst_node)->GetInPoint(con.ids.point).info->offset_to_node,
+                });
+            }
+        }
+    }
+
+    void EdgeGrid::Rebuild(const Circuit &circuit)
+    {
+        edges.clear();
+        free_slots.clear();
+        node_edges.clear();
+        cells.clear();
+        dirty_nodes.clear();
+
+        // Every connection is listed in exactly one 'in' point, so we don't need the 'out' points here.
+        for (const NodeStorage &node : circuit.nodes)
+            AddNodeInEdges(circuit, *node);
+
+        RememberCircuitGeneration(circuit);
+    }
+
+    void EdgeGrid::RememberCircuitGeneration(const Circuit &circuit)
+    {
+        synced_generation = circuit.Generation();
+    }
+
+    void EdgeGrid::MarkNodeDirty(BasicNode::id_t id)
+    {
+        dirty_nodes.insert(id);
+    }
+
+    void EdgeGrid::Update(const Circuit &circuit)
+    {
+        if (dirty_nodes.empty())
+        {
+            if (circuit.Generation() != synced_generation)
+            {
+                Rebuild(circuit);
+            }
+        }
+        else
+        {
+            // Remove all edges touching the dirty nodes.
+            for (BasicNode::id_t id : dirty_nodes)
+            {
+                auto it = node_edges.find(id);
+                if (it == node_edges.end())
+                    continue;
+                std::vector<std::uint32_t> slots = it->second; // A copy, since `RemoveEdge` modifies it.
+                for (std::uint32_t slot : slots)
+                    RemoveEdge(slot);
+            }
+
+            // Re-add them from the current connection lists. Deleted nodes are simply not found.
+            for (BasicNode::id_t id : dirty_nodes)
+            {
+                if (const NodeStorage *node = circuit.FindNodeIfExists(id))
+                    AddNodeEdges(circuit, **node);
+            }
+
+            dirty_nodes.clear();
+            RememberCircuitGeneration(circuit);
+        }
+    }
+
+    std::vector<const EdgeGrid::Edge *> EdgeGrid::QueryRect(ivec2 a, ivec2 b) const
+    {
+        std::vector<std::uint32_t> slots;
+
+        ivec2 cell_a = PixelToCell(a), cell_b = PixelToCell(b);
+        for (ivec2 cell = cell_a; cell.y <= cell_b.y; cell.y++)
+        for (cell.x = cell_a.x; cell.x <= cell_b.x; cell.x++)
+        {
+            auto it = cells.find(CellKey(cell));
+            if (it != cells.end())
+                slots.insert(slots.end(), it->second.begin(), it->second.end());
+        }
+
+        // Edges spanning several cells are found more than once.
+        std::sort(slots.begin(), slots.end());
+        slots.erase(std::unique(slots.begin(), slots.end()), slots.end());
+
+        std::vector<const Edge *> ret;
+        ret.reserve(slots.size());
+        for (std::uint32_t slot : slots)
+            ret.push_back(&edges[slot]);
+        return ret;
+    }
+
+    std::optional<EdgeGrid::ResolvedEdge> EdgeGrid::Resolve(const Circuit &circuit, const Edge &edge)
+    {
+        const NodeStorage *src_node = circuit.FindNodeIfExists(edge.src_node);
+        const NodeStorage *dst_node = circuit.FindNodeIfExists(edge.dst_node);
+        if (!src_node || !dst_node || edge.src_point >= (*src_node)->OutPointCount() || edge.dst_point >= (*dst_node)->InPointCount())
+            return {};
+
+        ResolvedEdge ret;
+        ret.src_node = &**src_node;
+        ret.dst_node = &**dst_node;
+        ret.src_point = &ret.src_node->GetOutPoint(edge.src_point);
+        ret.dst_point = &ret.dst_node->GetInPoint(edge.dst_point);
+
+        auto in_con = std::find_if(ret.dst_point->connections.begin(), ret.dst_point->connections.end(), [&](const BasicNode::InPointCon &con)
+        {
+            return con.ids == BasicNode::NodeAndPointId{edge.src_node, edge.src_point};
+        });
+        if (in_con == ret.dst_point->connections.end())
+            return {};
+        ret.is_inverted = in_con->is_inverted;
+
+        return ret;
+    }
+}
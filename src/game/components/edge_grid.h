@@ -0,0 +1,81 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "game/components/circuit.h"
+#include "utils/mat.h"
+
+namespace Components
+{
+    // A uniform grid over the node connections, for culling them when rendering and for picking them with the eraser.
+    // Each connection is added to all cells its segment passes through.
+    //
+    // Instead of updating the connections immediately, call `MarkNodeDirty()` for every node that was moved, created, deleted, connected or disconnected,
+    // then call `Update()` once all changes are done. It re-adds all connections of the dirty nodes.
+    class EdgeGrid
+    {
+      public:
+        static constexpr int cell_size = 32;
+
+        struct Edge
+        {
+            BasicNode::id_t src_node = 0;
+            int src_point = 0; // An 'out' point.
+            BasicNode::id_t dst_node = 0;
+            int dst_point = 0; // An 'in' point.
+            ivec2 pos_src{}, pos_dst{}; // Absolute positions of the points.
+        };
+
+        struct ResolvedEdge
+        {
+            const BasicNode *src_node = nullptr;
+            const BasicNode *dst_node = nullptr;
+            const BasicNode::OutPoint *src_point = nullptr;
+            const BasicNode::InPoint *dst_point = nullptr;
+            bool is_inverted = false;
+        };
+
+      private:
+        std::vector<Edge> edges; // Some slots are free, see `free_slots`.
+        std::vector<std::uint32_t> free_slots;
+        std::unordered_map<BasicNode::id_t, std::vector<std::uint32_t>> node_edges; // Slots of all edges touching each node.
+        std::unordered_map<std::uint64_t, std::vector<std::uint32_t>> cells;
+        std::unordered_set<BasicNode::id_t> dirty_nodes;
+
+        // `Circuit::Generation()` as of the last sync, used to detect circuit changes that bypassed the grid.
+        std::uint64_t synced_generation = 0;
+
+        [[nodiscard]] static std::uint64_t CellKey(ivec2 cell);
+        [[nodiscard]] static ivec2 PixelToCell(ivec2 pixel);
+
+        template <typename F>
+        static void ForEachCellOnSegment(ivec2 a, ivec2 b, F &&func); // `func` is `void func(ivec2 cell)`.
+
+        void AddEdge(const Edge &edge);
+        void RemoveEdge(std::uint32_t slot);
+        void AddNodeInEdges(const Circuit &circuit, const BasicNode &node);
+        void AddNodeEdges(const Circuit &circuit, const BasicNode &node); // Adds all 'in' connections of the node, and all 'out' connections to nodes that are not dirty.
+        void RememberCircuitGeneration(const Circuit &circuit);
+
+      public:
+        EdgeGrid() {}
+
+        void Rebuild(const Circuit &circuit);
+
+        void MarkNodeDirty(BasicNode::id_t id);
+        // Applies the changes to the dirty nodes. Also rebuilds the grid if the circuit was obviously changed behind our back.
+        void Update(const Circuit &circuit);
+
+        // Returns the edges whose segments pass through the cells touching the rectangle. `a` and `b` are inclusive.
+        // Each edge is listed once.
+        [[nodiscard]] std::vector<const Edge *> QueryRect(ivec2 a, ivec2 b) const;
+
+        // Finds the nodes and points of the edge in the circuit. Returns null if the connection no longer exists.
+        [[nodiscard]] static std::optional<ResolvedEdge> Resolve(const Circuit &circuit, const Edge &edge);
+    };
+}
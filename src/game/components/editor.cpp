@@ -1,10 +1,21 @@
 #include "editor.h"
 
+#include <algorithm>
 #include <array>
+#include <cmath>
 #include <vector>
 #include <set>
 
+#include "game/components/activity_map.h"
+#include "game/components/breakpoints.h"
 #include "game/components/circuit.h"
+#include "game/components/circuit_layer.h"
+#include "game/components/circuit_lod.h"
+#include "game/components/edge_grid.h"
+#include "game/components/minimap_image.h"
+#include "game/components/node_clipboard.h"
+#include "game/components/node_grid.h"
+#include "game/components/undo_history.h"
 #include "game/draw.h"
 #include "game/main.h"
 #include "reflection/full_with_poly.h"
@@ -40,11 +51,19 @@ namespace Components
 
         static constexpr int panel_h = 24;
         static constexpr ivec2 window_size_with_panel = screen_size - 40, window_size = window_size_with_panel - ivec2(0, panel_h);
-        static constexpr ivec2 area_size = ivec2(1024, 512), min_view_offset = -(area_size - window_size) / 2, max_view_offset = -min_view_offset + 1;
+        static constexpr ivec2 area_size = ivec2(1024, 512);
         static constexpr int mouse_min_drag_distance = 1, hover_radius = 3;
 
 
         GameState game_state = GameState::stopped;
+        Replay replay;
+        Probes probes;
+
+        ActivityMap activity_map;
+        bool show_activity_map = false;
+
+        Breakpoints breakpoints;
+        std::size_t last_fired_breakpoint = -1; // Index in `breakpoints`, or -1 if none.
 
         bool want_open = false;
         float open_close_state = 0;
@@ -62,6 +81,10 @@ namespace Components
         ivec2 view_drag_offset_relative_to_mouse{};
         fvec2 view_offset_vel{};
 
+        int zoom_level = 0; // The view is scaled down by `ZoomScale()`. Nodes can only be edited at zoom level 0.
+        static constexpr int max_zoom_level = 2; // This is enough to see the whole area.
+        static constexpr int lod_bundle_cell_size = 8; // When zoomed out, the connections are bundled by cells of this size (in screen pixels).
+
         ivec2 frame_offset{}; // Offset of the editor frame relative to the center of the screen.
         ivec2 window_offset{}; // Offset of the editor viewport (not counting the panel) relative to the center of the screen.
 
@@ -98,7 +121,13 @@ namespace Components
         fvec2 erasing_node_connection_pos_a{}, erasing_node_connection_pos_b{}; // Those are set only when `erasing_node_connection_con_index != -1`.
         bool now_erasing_connections_instead_of_nodes = false; // Has a meaningful value only if `(mouse.left.down() || mouse.left.released()) && eraser_mode`.
 
-        std::vector<BasicNode::id_t> recently_deleted_node_ids; // When deleting nodes, their IDs should be added here.
+        NodeGrid node_grid; // Must be updated when nodes are added, moved, or deleted.
+        EdgeGrid edge_grid; // Nodes must be marked as dirty when they are added, moved, deleted, or their connections change.
+        mutable CircuitLayer circuit_layer; // Same as `edge_grid`. Updated when rendering.
+        CircuitLod circuit_lod; // Same as `edge_grid`. Only updated when zoomed out.
+        UndoHistory undo_history; // All node edits must be recorded here.
+        std::vector<unsigned char> clipboard; // See `NodeClipboard`. Empty if nothing was copied.
+        mutable MinimapImage minimap_image = MinimapImage(-area_size/2, area_size+1); // Same as `edge_grid`, and must be notified about the circuit ticks. Uploaded when rendering.
 
         static constexpr int circuit_tick_period_when_in_editor_mode = 15;
         int circuit_tick_timer_for_editor_mode = 0;
@@ -255,6 +284,15 @@ namespace Components
             Input::Button stop = Input::r;
             Input::Button play_pause = Input::space;
             Input::Button advance_one_tick = Input::f;
+            Input::Button toggle_probe = Input::p;
+            Input::Button toggle_activity_map = Input::h;
+            Input::Button add_breakpoint = Input::b;
+            Input::Button zoom_in = Input::mouse_wheel_up;
+            Input::Button zoom_out = Input::mouse_wheel_down;
+            Input::Button undo = Input::z; // With Ctrl.
+            Input::Button redo = Input::y; // With Ctrl.
+            Input::Button copy = Input::c; // With Ctrl.
+            Input::Button paste = Input::v; // With Ctrl.
         };
         Hotkeys hotkeys;
 
@@ -290,8 +328,13 @@ namespace Components
 
         State() {}
 
+        [[nodiscard]] static size_t NodeIdToIndex(const Circuit &circuit, BasicNode::id_t id)
+        {
+            return &circuit.FindNodeOrThrow(id) - circuit.nodes.data();
+        }
+
         // Returns -1 if we don't hover over a node.
-        size_t CalcHoveredNodeIndex(const std::vector<NodeStorage> &nodes, ivec2 radius) const
+        size_t CalcHoveredNodeIndex(const Circuit &circuit, ivec2 radius) const
         {
             if (!mouse_in_window)
                 return -1;
@@ -301,8 +344,10 @@ namespace Components
             size_t closest_index = -1;
             int closest_dist_sqr = std::numeric_limits<int>::max();
 
-            for (size_t i = 0; i < nodes.size(); i++)
+            const std::vector<NodeStorage> &nodes = circuit.nodes;
+            for (BasicNode::id_t id : node_grid.QueryRect(mouse_abs_pos - radius, mouse_abs_pos + radius))
             {
+                size_t i = NodeIdToIndex(circuit, id);
                 if (!nodes[i]->VisuallyContainsPoint(mouse_abs_pos, radius))
                     continue;
 
@@ -317,10 +362,103 @@ namespace Components
             return closest_index;
         }
 
-        static void RunWorldTick(World &world, Circuit &circuit)
+        // Call this when a node is added, moved, deleted, or its connections change. Updates `edge_grid`, `circuit_layer`, and the other caches.
+        void MarkNodeDirty(BasicNode::id_t id)
+        {
+            edge_grid.MarkNodeDirty(id);
+            circuit_layer.MarkNodeDirty(id);
+            minimap_image.MarkNodeDirty(id);
+            circuit_lod.MarkDirty();
+        }
+
+        // How many circuit pixels are in one screen pixel.
+        [[nodiscard]] int ZoomScale() const
+        {
+            return 1 << zoom_level;
+        }
+        // The size of the visible area, in circuit pixels.
+        [[nodiscard]] ivec2 VisibleSize() const
+        {
+            return window_size * ZoomScale();
+        }
+        // The view offset limits, for the current zoom level. If the whole area is visible on some axis, the view is centered on it.
+        [[nodiscard]] ivec2 MinViewOffset() const
         {
+            return min(-(area_size - VisibleSize()) / 2, 0);
+        }
+        [[nodiscard]] ivec2 MaxViewOffset() const
+        {
+            return max((area_size - VisibleSize()) / 2 + 1, 0);
+        }
+
+        // Clamps `view_offset_float` and computes `view_offset` from it.
+        void UpdateViewOffset()
+        {
+            { // Clamp offset
+                ivec2 min_view_offset = MinViewOffset(), max_view_offset = MaxViewOffset();
+                for (int i = 0; i < 2; i++)
+                {
+                    if (view_offset_float[i] < min_view_offset[i])
+                    {
+                        view_offset_float[i] = min_view_offset[i];
+                        view_offset_vel[i] = 0;
+                    }
+                    else if (view_offset_float[i] > max_view_offset[i])
+                    {
+                        view_offset_float[i] = max_view_offset[i];
+                        view_offset_vel[i] = 0;
+                    }
+                }
+            }
+
+            // Compute rounded offset. When zoomed out, it's rounded to whole screen pixels, to avoid jitter.
+            view_offset = iround(view_offset_float / ZoomScale()) * ZoomScale();
+        }
+
+        // Changes the zoom level, keeping the circuit point under `anchor_pos` (in screen coordinates) in place.
+        void SetZoomLevel(int new_zoom_level, ivec2 anchor_pos)
+        {
+            clamp_var(new_zoom_level, 0, max_zoom_level);
+            if (new_zoom_level == zoom_level)
+                return;
+
+            ivec2 anchor_circuit_pos = (anchor_pos - window_offset) * ZoomScale() + view_offset;
+            zoom_level = new_zoom_level;
+            view_offset_float = anchor_circuit_pos - (anchor_pos - window_offset) * ZoomScale();
+            view_offset_vel = fvec2(0);
+            need_recalc_hovered_node = true;
+            UpdateViewOffset();
+        }
+
+        void RunWorldTick(World &world, Circuit &circuit)
+        {
+            // The recording starts at the first tick after the world was (re)started.
+            if (!replay.IsRecording())
+            {
+                replay.Start(world, circuit);
+                try
+                {
+                    probes.StartRecording(circuit, "probes.vcd");
+                }
+                catch (std::exception &e)
+                {
+                    Interface::MessageBox("Error", Str("Unable to start recording the probes:\n", e.what()));
+                }
+            }
+
+            World::Controls controls = World::Controls::FromKeyboard();
             circuit.Tick(world);
-            world.Tick();
+            probes.AddTick(circuit);
+            minimap_image.AddTick(circuit);
+            if (show_activity_map)
+                activity_map.AddTick(circuit);
+
+            // Finish this tick normally, but don't start the next one.
+            last_fired_breakpoint = breakpoints.Check(circuit);
+            if (last_fired_breakpoint != std::size_t(-1))
+                game_state = GameState::paused;
+            world.Tick(controls);
+            replay.AddTick(controls, world, circuit);
         }
         static void RunWorldTickPersistent(World &world)
         {
@@ -347,6 +485,22 @@ namespace Components
     {
         return state->game_state;
     }
+    const Replay &Editor::GetReplay() const
+    {
+        return state->replay;
+    }
+    const Probes &Editor::GetProbes() const
+    {
+        return state->probes;
+    }
+    Breakpoints &Editor::GetBreakpoints()
+    {
+        return state->breakpoints;
+    }
+    std::size_t Editor::LastFiredBreakpoint() const
+    {
+        return state->last_fired_breakpoint;
+    }
 
     void Editor::Tick(std::optional<World> &world, const std::optional<World> &saved_world, Circuit &circuit, MenuController &menu_controller, TooltipController &tooltip_controller)
     {
@@ -407,20 +561,20 @@ namespace Components
             {
                 s.now_dragging_view = true;
                 s.now_dragging_view_using_rmb = !mouse.middle.pressed();
-                s.view_drag_offset_relative_to_mouse = mouse.pos() + s.view_offset;
+                s.view_drag_offset_relative_to_mouse = mouse.pos() * s.ZoomScale() + s.view_offset;
                 s.view_offset_vel = fvec2(0);
             }
             // Stop dragging
             if (s.now_dragging_view && (s.now_dragging_view_using_rmb ? mouse.right : mouse.middle).up())
             {
                 s.now_dragging_view = false;
-                s.view_offset_vel = -mouse.pos_delta();
+                s.view_offset_vel = -mouse.pos_delta() * s.ZoomScale();
             }
 
             // Change offset
             if (s.now_dragging_view)
             {
-                s.view_offset_float = s.view_drag_offset_relative_to_mouse - mouse.pos();
+                s.view_offset_float = s.view_drag_offset_relative_to_mouse - mouse.pos() * s.ZoomScale();
             }
             else
             {
@@ -436,24 +590,16 @@ namespace Components
                 }
             }
 
-            { // Clamp offset
-                for (int i = 0; i < 2; i++)
-                {
-                    if (s.view_offset_float[i] < s.min_view_offset[i])
-                    {
-                        s.view_offset_float[i] = s.min_view_offset[i];
-                        s.view_offset_vel[i] = 0;
-                    }
-                    else if (s.view_offset_float[i] > s.max_view_offset[i])
-                    {
-                        s.view_offset_float[i] = s.max_view_offset[i];
-                        s.view_offset_vel[i] = 0;
-                    }
-                }
+            // Zoom
+            if (s.mouse_in_window && !s.now_dragging_view && !s.now_creating_rect_selection && !s.now_dragging_selected_nodes && !s.now_creating_node_connection)
+            {
+                if (s.hotkeys.zoom_in.pressed())
+                    s.SetZoomLevel(s.zoom_level - 1, mouse.pos());
+                if (s.hotkeys.zoom_out.pressed() && !s.held_node && !s.eraser_mode)
+                    s.SetZoomLevel(s.zoom_level + 1, mouse.pos());
             }
 
-            // Compute rounded offset
-            s.view_offset = iround(s.view_offset_float);
+            s.UpdateViewOffset();
         }
 
         { // Compute frame and window offsets
@@ -567,6 +713,15 @@ namespace Components
             if (s.buttons.stop.IsPressed() || s.hotkeys.stop.pressed())
             {
                 s.game_state = GameState::stopped;
+                s.replay.Stop();
+                try
+                {
+                    s.probes.StopRecording();
+                }
+                catch (std::exception &e)
+                {
+                    Interface::MessageBox("Error", e.what());
+                }
                 if (world && saved_world)
                 {
                     World tmp_world = std::move(*world);
@@ -593,18 +748,140 @@ namespace Components
             }
         }
 
+        // Nodes can't be edited when zoomed out, so picking a tool zooms in.
+        if ((s.held_node || s.eraser_mode) && s.zoom_level != 0)
+            s.SetZoomLevel(0, s.window_offset);
+
+        { // Make sure the node and edge grids are up to date
+            s.node_grid.RebuildIfOutdated(circuit);
+            s.edge_grid.Update(circuit);
+            s.undo_history.ClearIfOutdated(circuit);
+        }
+
+        // Undo and redo
+        if (s.fully_extended && s.game_state == GameState::stopped && !menu_controller.MenuIsOpen()
+            && !s.now_creating_rect_selection && !s.now_dragging_selected_nodes && !s.now_creating_node_connection && s.erasing_node_connection_node_index == size_t(-1)
+            && (Input::Button(Input::l_ctrl).down() || Input::Button(Input::r_ctrl).down()))
+        {
+            std::vector<BasicNode::id_t> changed_ids;
+            if ((s.hotkeys.undo.pressed() && s.undo_history.Undo(circuit, changed_ids)) || (s.hotkeys.redo.pressed() && s.undo_history.Redo(circuit, changed_ids)))
+            {
+                for (BasicNode::id_t id : changed_ids)
+                {
+                    s.node_grid.RemoveNode(circuit, id);
+                    if (const NodeStorage *node = circuit.FindNodeIfExists(id))
+                        s.node_grid.AddNode(circuit, **node);
+                    s.MarkNodeDirty(id);
+                }
+
+                // The indices are no longer valid.
+                s.selected_node_indices.clear();
+                s.hovering_over_node_index = -1;
+                s.need_recalc_hovered_node = true;
+            }
+        }
+
+        // Copy and paste
+        if (s.fully_extended && s.game_state == GameState::stopped && !menu_controller.MenuIsOpen()
+            && !s.now_creating_rect_selection && !s.now_dragging_selected_nodes && !s.now_creating_node_connection
+            && (Input::Button(Input::l_ctrl).down() || Input::Button(Input::r_ctrl).down()))
+        {
+            if (s.hotkeys.copy.pressed() && !s.selected_node_indices.empty())
+            {
+                std::vector<BasicNode::id_t> ids;
+                for (size_t index : s.selected_node_indices)
+                    ids.push_back(circuit.nodes[index]->id);
+                s.clipboard = NodeClipboard::Copy(circuit, std::move(ids));
+            }
+
+            if (s.hotkeys.paste.pressed() && !s.clipboard.empty() && s.mouse_in_window && s.zoom_level == 0 && !s.held_node && !s.eraser_mode)
+            {
+                NodeClipboard::Data data = NodeClipboard::Load(s.clipboard);
+                ivec2 paste_pos = mouse.pos() - s.window_offset + s.view_offset;
+
+                // Make sure the pasted nodes are in bounds, and don't overlap with the existing nodes.
+                bool can_paste = true;
+                for (const NodeStorage &node : data.nodes)
+                {
+                    ivec2 new_pos = paste_pos + node->pos;
+                    ivec2 half_extent = node->GetVisualHalfExtent();
+                    if ((new_pos < -s.area_size/2).any() || (new_pos > s.area_size/2).any())
+                    {
+                        can_paste = false;
+                        break;
+                    }
+
+                    for (BasicNode::id_t id : s.node_grid.QueryRect(new_pos - half_extent, new_pos + half_extent))
+                    {
+                        if (circuit.FindNodeOrThrow(id)->VisuallyContainsPoint(new_pos, half_extent))
+                        {
+                            can_paste = false;
+                            break;
+                        }
+                    }
+                    if (!can_paste)
+                        break;
+                }
+
+                if (can_paste)
+                {
+                    Circuit::Batch batch(circuit);
+                    std::vector<BasicNode::id_t> new_ids = NodeClipboard::Paste(batch, data, paste_pos);
+                    batch.Commit();
+
+                    for (BasicNode::id_t id : new_ids)
+                    {
+                        s.node_grid.AddNode(circuit, *circuit.FindNodeOrThrow(id));
+                        s.MarkNodeDirty(id);
+                    }
+                    s.undo_history.RecordNodesCreated(circuit, new_ids);
+
+                    // Select the pasted nodes. They are at the end of the list, since they have the largest ids.
+                    s.selected_node_indices.clear();
+                    for (size_t i = circuit.nodes.size() - new_ids.size(); i < circuit.nodes.size(); i++)
+                        s.selected_node_indices.insert(i);
+                    s.need_recalc_hovered_node = true;
+                }
+            }
+        }
+
         { // Detect hovered node if needed
-            if (!s.fully_extended)
+            if (!s.fully_extended || s.zoom_level != 0)
             {
                 s.hovering_over_node_index = -1;
             }
             else if (s.eraser_mode != s.prev_eraser_mode || mouse.pos_delta() || s.view_offset != s.prev_view_offset || s.need_recalc_hovered_node)
             {
                 s.need_recalc_hovered_node = false;
-                s.hovering_over_node_index = s.CalcHoveredNodeIndex(circuit.nodes, s.held_node ? s.held_node->GetVisualHalfExtent() : ivec2(s.hover_radius));
+                s.hovering_over_node_index = s.CalcHoveredNodeIndex(circuit, s.held_node ? s.held_node->GetVisualHalfExtent() : ivec2(s.hover_radius));
             }
         }
 
+        // Toggling the activity map
+        if (s.fully_extended && s.hotkeys.toggle_activity_map.pressed())
+        {
+            s.show_activity_map = !s.show_activity_map;
+            s.activity_map.Reset();
+        }
+
+        // Toggling probes on the hovered 'out' point
+        if (s.fully_extended && s.mouse_in_window && !s.held_node && !s.eraser_mode && s.hovering_over_node_index != size_t(-1) && s.hotkeys.toggle_probe.pressed())
+        {
+            const BasicNode &node = *circuit.nodes[s.hovering_over_node_index];
+            int point_index = node.GetClosestConnectionPoint<BasicNode::Dir::out>(mouse.pos() - s.window_offset + s.view_offset);
+            if (point_index != -1)
+                s.probes.ToggleProbe({.node = node.id, .point = point_index});
+        }
+
+        // Adding a breakpoint on the hovered 'out' point
+        if (s.fully_extended && s.mouse_in_window && !s.held_node && !s.eraser_mode && s.hovering_over_node_index != size_t(-1) && s.hotkeys.add_breakpoint.pressed())
+        {
+            const BasicNode &node = *circuit.nodes[s.hovering_over_node_index];
+            int point_index = node.GetClosestConnectionPoint<BasicNode::Dir::out>(mouse.pos() - s.window_offset + s.view_offset);
+            if (point_index != -1)
+                s.breakpoints.Add(Breakpoints::TermToString({.kind = Breakpoints::TermKind::rises, .node = node.id, .point = point_index}));
+        }
+
         // Selection (and erasing nodes)
         if (s.fully_extended)
         {
@@ -616,8 +893,14 @@ namespace Components
                 s.selected_node_indices.clear();
             }
 
+            // When zoomed out, clicking zooms in.
+            if (s.mouse_in_window && s.zoom_level != 0)
+            {
+                if (mouse.left.pressed() && !menu_controller.MenuIsOpen())
+                    s.SetZoomLevel(0, mouse.pos());
+            }
             // Process clicks in selection or eraser mode.
-            if (s.mouse_in_window && !s.held_node)
+            else if (s.mouse_in_window && !s.held_node)
             {
                 // Clicked on an empty space, form a rectangular selection
                 if (mouse.left.pressed() && s.hovering_over_node_index == size_t(-1) && !menu_controller.MenuIsOpen() && s.game_state == GameState::stopped)
@@ -634,8 +917,13 @@ namespace Components
                     {
                         if (!s.now_erasing_connections_instead_of_nodes) // If not erasing a connection...
                         {
-                            s.recently_deleted_node_ids.push_back(circuit.nodes[s.hovering_over_node_index]->id);
-                            circuit.nodes.erase(circuit.nodes.begin() + s.hovering_over_node_index);
+                            BasicNode::id_t id = circuit.nodes[s.hovering_over_node_index]->id;
+                            s.undo_history.RecordNodesDeleted(circuit, {id});
+                            Circuit::Batch batch(circuit);
+                            batch.DeleteNode(id);
+                            batch.Commit();
+                            s.node_grid.RemoveNode(circuit, id);
+                            s.MarkNodeDirty(id);
                             s.hovering_over_node_index = -1;
                             s.need_recalc_hovered_node = true;
                         }
@@ -689,29 +977,42 @@ namespace Components
                             return (node->pos - half_extent >= s.rect_selection_pos).all() && (node->pos + half_extent < s.rect_selection_pos + s.rect_selection_size).all();
                         };
 
+                        // Only the nodes found in the grid can be in the selection. The ids are sorted, so are the indices.
+                        std::vector<size_t> candidate_indices;
+                        for (BasicNode::id_t id : s.node_grid.QueryRect(s.rect_selection_pos, s.rect_selection_pos + s.rect_selection_size - 1))
+                        {
+                            size_t i = s.NodeIdToIndex(circuit, id);
+                            if (NodeIsInSelection(circuit.nodes[i]))
+                                candidate_indices.push_back(i);
+                        }
+
                         if (s.eraser_mode)
                         {
                             s.hovering_over_node_index = -1;
                             s.need_recalc_hovered_node = true;
 
-                            std::erase_if(circuit.nodes, [&](const NodeStorage &node)
+                            std::vector<BasicNode::id_t> deleted_ids;
+                            for (size_t i : candidate_indices)
+                                deleted_ids.push_back(circuit.nodes[i]->id);
+                            s.undo_history.RecordNodesDeleted(circuit, deleted_ids);
+
+                            Circuit::Batch batch(circuit);
+                            for (BasicNode::id_t id : deleted_ids)
+                                batch.DeleteNode(id);
+                            batch.Commit();
+                            for (BasicNode::id_t id : deleted_ids)
                             {
-                                if (!NodeIsInSelection(node))
-                                    return false;
-                                s.recently_deleted_node_ids.push_back(node->id);
-                                return true;
-                            });
+                                s.node_grid.RemoveNode(circuit, id);
+                                s.MarkNodeDirty(id);
+                            }
                         }
                         else
                         {
                             if (!s.selection_add_modifier_down && !s.selection_subtract_modifier_down)
                                 s.selected_node_indices.clear();
 
-                            for (size_t i = 0; i < circuit.nodes.size(); i++)
+                            for (size_t i : candidate_indices)
                             {
-                                if (!NodeIsInSelection(circuit.nodes[i]))
-                                    continue;
-
                                 if (s.selection_subtract_modifier_down)
                                     s.selected_node_indices.erase(i);
                                 else
@@ -760,26 +1061,23 @@ namespace Components
                         // Make sure the dragged nodes don't overlap with the other nodes.
                         if (can_move)
                         {
-                            auto sel_index_iter = s.selected_node_indices.begin();
-                            for (size_t static_node_index = 0; static_node_index < circuit.nodes.size(); static_node_index++)
+                            size_t i = 0;
+                            for (size_t moving_node_index : s.selected_node_indices)
                             {
-                                // Skip node indices that are selected.
-                                if (sel_index_iter != s.selected_node_indices.end() && *sel_index_iter == static_node_index)
-                                {
-                                    sel_index_iter++;
-                                    continue;
-                                }
+                                const BasicNode &moving_node = *circuit.nodes[moving_node_index];
+                                ivec2 moving_half_extent = moving_node.GetVisualHalfExtent();
 
-                                const BasicNode &static_node = *circuit.nodes[static_node_index];
+                                ivec2 new_moving_node_pos = abs_mouse_pos + s.dragged_nodes_offsets_to_mouse_pos[i++];
 
-                                size_t i = 0;
-                                for (size_t moving_node_index : s.selected_node_indices)
+                                for (BasicNode::id_t static_node_id : s.node_grid.QueryRect(new_moving_node_pos - moving_half_extent, new_moving_node_pos + moving_half_extent))
                                 {
-                                    const BasicNode &moving_node = *circuit.nodes[moving_node_index];
+                                    size_t static_node_index = s.NodeIdToIndex(circuit, static_node_id);
 
-                                    ivec2 new_moving_node_pos = abs_mouse_pos + s.dragged_nodes_offsets_to_mouse_pos[i++];
+                                    // Skip node indices that are selected.
+                                    if (s.selected_node_indices.contains(static_node_index))
+                                        continue;
 
-                                    if (static_node.VisuallyContainsPoint(new_moving_node_pos, moving_node.GetVisualHalfExtent()))
+                                    if (circuit.nodes[static_node_index]->VisuallyContainsPoint(new_moving_node_pos, moving_half_extent))
                                     {
                                         can_move = false;
                                         break;
@@ -791,8 +1089,17 @@ namespace Components
                             }
                         }
 
+                        if (can_move)
+                        {
+                            size_t i = 0;
+                            for (size_t index : s.selected_node_indices)
+                            {
+                                ivec2 offset = s.dragged_nodes_offsets_to_mouse_pos[i++];
+                                s.undo_history.RecordNodeMoved(circuit.nodes[index]->id, s.dragging_nodes_initial_click_pos + offset, circuit.nodes[index]->pos);
+                            }
+                        }
                         // If there's something wrong with the new node positions, move them back to their original location.
-                        if (!can_move)
+                        else
                         {
                             s.need_recalc_hovered_node = true;
 
@@ -800,6 +1107,8 @@ namespace Components
                             for (size_t index : s.selected_node_indices)
                             {
                                 circuit.nodes[index]->pos = s.dragging_nodes_initial_click_pos + s.dragged_nodes_offsets_to_mouse_pos[i++];
+                                s.node_grid.MoveNode(*circuit.nodes[index]);
+                                s.MarkNodeDirty(circuit.nodes[index]->id);
                             }
                         }
                     }
@@ -810,6 +1119,8 @@ namespace Components
                     for (size_t index : s.selected_node_indices)
                     {
                         circuit.nodes[index]->pos = abs_mouse_pos + s.dragged_nodes_offsets_to_mouse_pos[i++];
+                        s.node_grid.MoveNode(*circuit.nodes[index]);
+                        s.MarkNodeDirty(circuit.nodes[index]->id);
                     }
                 }
             }
@@ -847,7 +1158,11 @@ namespace Components
                     int dst_point_index = dst_node.GetClosestConnectionPoint<BasicNode::Dir::in>(mouse_abs_pos);
                     if (dst_point_index != -1)
                     {
+                        s.undo_history.BeginConnectionChange(circuit, {src_node.id, dst_node.id});
                         src_node.Connect(s.node_connection_src_point_index, dst_node, dst_point_index, s.create_inverted_connections);
+                        s.undo_history.EndConnectionChange(circuit);
+                        s.MarkNodeDirty(src_node.id);
+                        s.MarkNodeDirty(dst_node.id);
                     }
                 }
 
@@ -886,6 +1201,9 @@ namespace Components
 
                     float dist_to_nearest_con = 10; // Minimal distance to connection.
 
+                    // Only the connections passing near the mouse are considered.
+                    std::vector<const EdgeGrid::Edge *> nearby_edges = s.edge_grid.QueryRect(mouse_abs_pos - int(dist_to_nearest_con), mouse_abs_pos + int(dist_to_nearest_con));
+
                     auto UpdateSelectedCon = [&](bool is_out, int point_index)
                     {
                         Meta::with_cexpr_flags(is_out) >> [&](auto is_out_tag)
@@ -894,9 +1212,17 @@ namespace Components
 
                             const auto &point = node.GetInOrOutPoint<is_out>(point_index);
 
-                            for (int con_index = 0; con_index < int(point.connections.size()); con_index++)
+                            for (const EdgeGrid::Edge *edge : nearby_edges)
                             {
-                                const BasicNode::NodeAndPointId &remote_ids = point.connections[con_index].ids;
+                                BasicNode::NodeAndPointId local_ids = is_out ? BasicNode::NodeAndPointId{edge->src_node, edge->src_point} : BasicNode::NodeAndPointId{edge->dst_node, edge->dst_point};
+                                BasicNode::NodeAndPointId remote_ids = is_out ? BasicNode::NodeAndPointId{edge->dst_node, edge->dst_point} : BasicNode::NodeAndPointId{edge->src_node, edge->src_point};
+                                if (local_ids != BasicNode::NodeAndPointId{node.id, point_index})
+                                    continue;
+
+                                auto con_iter = std::find_if(point.connections.begin(), point.connections.end(), [&](const auto &con){return con.ids == remote_ids;});
+                                if (con_iter == point.connections.end())
+                                    continue;
+                                int con_index = con_iter - point.connections.begin();
 
                                 const BasicNode &remote_node = *circuit.FindNodeOrThrow(remote_ids.node);
                                 const auto &remote_point = remote_node.GetInOrOutPoint<!is_out>(remote_ids.point);
@@ -940,7 +1266,13 @@ namespace Components
                 if (s.eraser_mode && s.erasing_node_connection_node_index != size_t(-1) && s.erasing_node_connection_con_index != -1 && !menu_controller.MenuIsOpen() && s.game_state == GameState::stopped)
                 {
                     BasicNode &node = *circuit.nodes[s.erasing_node_connection_node_index];
+                    BasicNode::id_t remote_id = s.erasing_node_connection_point_type_is_out
+                        ? node.GetOutPoint(s.erasing_node_connection_point_index).connections[s.erasing_node_connection_con_index].ids.node
+                        : node.GetInPoint(s.erasing_node_connection_point_index).connections[s.erasing_node_connection_con_index].ids.node;
+                    s.undo_history.BeginConnectionChange(circuit, {node.id, remote_id});
                     node.Disconnect(circuit, s.erasing_node_connection_point_index, s.erasing_node_connection_point_type_is_out, s.erasing_node_connection_con_index);
+                    s.undo_history.EndConnectionChange(circuit);
+                    s.MarkNodeDirty(node.id); // The connection touched this node, so this is enough to remove it.
                 }
 
                 s.erasing_node_connection_node_index = -1;
@@ -954,49 +1286,30 @@ namespace Components
         {
             if (mouse.left.pressed() && s.mouse_in_window && s.held_node && s.hovering_over_node_index == size_t(-1) && !menu_controller.MenuIsOpen() && s.game_state == GameState::stopped)
             {
-                BasicNode::id_t new_node_id = circuit.nodes.empty() ? 0 : circuit.nodes.back()->id + 1;
+                NodeStorage new_node = s.held_node;
+                new_node->pos = mouse.pos() - s.window_offset + s.view_offset;
 
-                BasicNode &new_node = *circuit.nodes.emplace_back(s.held_node);
-                new_node.pos = mouse.pos() - s.window_offset + s.view_offset;
-                new_node.id = new_node_id;
+                Circuit::Batch batch(circuit);
+                BasicNode::id_t new_node_id = batch.AddNode(std::move(new_node));
+                batch.Commit();
+                s.node_grid.AddNode(circuit, *circuit.FindNodeOrThrow(new_node_id));
+                s.undo_history.RecordNodesCreated(circuit, {new_node_id});
+                s.MarkNodeDirty(new_node_id);
 
                 s.need_recalc_hovered_node = true;
             }
         }
 
-        { // Renormalize nodes, if needed (this must be close to the end of `Tick()`, after all node manipulations)
-            if (s.recently_deleted_node_ids.size() > 0)
-            {
-                // Sort IDs to allow binary search.
-                std::sort(s.recently_deleted_node_ids.begin(), s.recently_deleted_node_ids.end());
-
-                // Check if a node with the specified ID was recently deleted.
-                auto NodeIdWasDeleted = [&](BasicNode::id_t id)
-                {
-                    return std::binary_search(s.recently_deleted_node_ids.begin(), s.recently_deleted_node_ids.end(), id);
-                };
-
-                // For each existing node, remove all connections to nodes that were deleted.
-                for (NodeStorage &node : circuit.nodes)
-                {
-                    int in_points = node->InPointCount();
-                    int out_points = node->OutPointCount();
+        { // Update the caches (this must be close to the end of `Tick()`, after all node manipulations)
+            // Everything that was edited during this tick becomes one undo step.
+            s.undo_history.FinishStep(circuit);
 
-                    for (int i = 0; i < in_points; i++)
-                    {
-                        BasicNode::InPoint &point = node->GetInPoint(i);
-                        std::erase_if(point.connections, [&](const BasicNode::InPointCon &con){return NodeIdWasDeleted(con.ids.node);});
-                    }
-                    for (int i = 0; i < out_points; i++)
-                    {
-                        BasicNode::OutPoint &point = node->GetOutPoint(i);
-                        std::erase_if(point.connections, [&](const BasicNode::OutPointCon &con){return NodeIdWasDeleted(con.ids.node);});
-                    }
-                }
+            // Apply the node changes to the edge grid.
+            s.edge_grid.Update(circuit);
 
-                // Clear the list of deleted IDs.
-                s.recently_deleted_node_ids.clear();
-            }
+            // Rebuild the zoomed out view if needed.
+            if (s.zoom_level != 0)
+                s.circuit_lod.Update(circuit, s.lod_bundle_cell_size * s.ZoomScale());
         }
 
         { // Circuit tick (in the editor mode only)
@@ -1011,6 +1324,9 @@ namespace Components
                 {
                     s.circuit_tick_timer_for_editor_mode = 0;
                     circuit.Tick(*world);
+                    s.minimap_image.AddTick(circuit);
+                    if (s.show_activity_map)
+                        s.activity_map.AddTick(circuit);
                 }
             }
         }
@@ -1075,8 +1391,9 @@ namespace Components
 
             auto GetLineAlpha = [&](int index) {return index % sub_cell_count == 0 ? grid_alpha_alt : grid_alpha;};
 
-            ivec2 grid_center_cell = div_ex(-s.view_offset, cell_size);
-            ivec2 grid_center = mod_ex(-s.view_offset, cell_size);
+            // When zoomed out, the cells are bigger, so the lines are at the same distance on the screen.
+            ivec2 grid_center_cell = div_ex(-s.view_offset / s.ZoomScale(), cell_size);
+            ivec2 grid_center = mod_ex(-s.view_offset / s.ZoomScale(), cell_size);
 
             for (int x = 0;; x++)
             {
@@ -1128,51 +1445,142 @@ namespace Components
                 // Border
                 Draw::RectFrame(minimap_pos-1, minimap_size+2, 1, false, color_border);
 
-                ivec2 rect_size = iround(s.window_size / fvec2(s.area_size) * minimap_size);
+                // Circuit
+                s.minimap_image.Update(circuit);
+                r.Finish();
+                r.SetTexture(s.minimap_image.GetTexture());
+                r.iquad(minimap_pos, minimap_size).tex(fvec2(0), s.minimap_image.GetTexture().Size());
+                r.Finish();
+                r.SetTexture(texture_main);
+
+                ivec2 rect_size = min(iround(s.VisibleSize() / fvec2(s.area_size) * minimap_size), minimap_size);
 
-                fvec2 relative_view_offset = (s.view_offset - s.min_view_offset) / fvec2(s.max_view_offset -s.min_view_offset);
+                ivec2 min_view_offset = s.MinViewOffset(), max_view_offset = s.MaxViewOffset();
+                fvec2 relative_view_offset = (s.view_offset - min_view_offset) / fvec2(max(max_view_offset - min_view_offset, 1));
                 ivec2 rect_pos = iround((minimap_size - rect_size) * relative_view_offset);
                 r.iquad(minimap_pos + rect_pos, rect_size).color(color_marker_border);
                 r.iquad(minimap_pos + rect_pos+1, rect_size-2).color(color_marker_bg);
             }
         }
 
+        // Circuit, zoomed out
+        if (s.partially_extended && s.zoom_level != 0)
+        {
+            constexpr fvec3 color_sparse = fvec3(0,60,120)/255, color_dense = fvec3(10,141,255)/255, color_bundle = fvec3(0,120,230)/255;
+            constexpr int dense_node_count = 4; // If a pixel has this many nodes, it gets the densest color.
+
+            int scale = s.ZoomScale();
+            ivec2 view_a = s.view_offset - s.VisibleSize()/2, view_b = s.view_offset + s.VisibleSize()/2;
+            auto CircuitToScreen = [&](ivec2 pos) {return s.window_offset + div_ex(pos - s.view_offset, scale);};
+
+            // Set scissor box
+            r.Finish();
+            Graphics::Scissor::Enable();
+            FINALLY( r.Finish(); Graphics::Scissor::Disable(); )
+            Graphics::Scissor::SetBounds_FlipY(screen_size/2 + s.window_offset - s.window_size/2, s.window_size, screen_size.y);
+
+            // Connection bundles
+            for (const CircuitLod::Bundle &bundle : s.circuit_lod.GetBundles())
+            {
+                if ((max(bundle.a, bundle.b) < view_a).any() || (min(bundle.a, bundle.b) > view_b).any())
+                    continue;
+
+                float alpha = clamp_max(0.2 + 0.1 * std::log2(bundle.count), 0.7);
+                Draw::Line(CircuitToScreen(bundle.a) + 0.5, CircuitToScreen(bundle.b) + 0.5, 1).color(color_bundle).alpha(alpha);
+            }
+
+            // Nodes, as node density per pixel
+            s.circuit_lod.ForEachCell(view_a, view_b, scale, [&](ivec2 cell_pos, std::uint32_t count)
+            {
+                float t = clamp_max((count - 1) / float(dense_node_count - 1), 1);
+                r.iquad(CircuitToScreen(cell_pos), ivec2(1)).color(mix(t, color_sparse, color_dense));
+            });
+        }
+
         // Circuit
-        if (s.partially_extended)
+        if (s.partially_extended && s.zoom_level == 0)
         {
+            ivec2 view_a = s.view_offset - s.window_size/2, view_b = s.view_offset + s.window_size/2;
+
+            // Render the missing parts of the cached circuit layer. This must be done before setting the scissor box.
+            s.circuit_layer.Update(circuit, s.node_grid, s.edge_grid, view_a, view_b);
+
             // Set scissor box
             r.Finish();
             Graphics::Scissor::Enable();
             FINALLY( r.Finish(); Graphics::Scissor::Disable(); )
             Graphics::Scissor::SetBounds_FlipY(screen_size/2 + s.window_offset - s.window_size/2, s.window_size, screen_size.y);
 
-            // Render nodes
-            for (const NodeStorage &node : circuit.nodes)
+            // Render the unpowered circuit from the cache
+            s.circuit_layer.Render(view_a, view_b, s.window_offset - s.view_offset);
+
+            // Render the powered parts of the nodes on top of it.
+            // The connections must stay on top of the nodes, so we remember the ones passing over those nodes, to redraw them.
+            std::vector<const EdgeGrid::Edge *> edges_over_powered_nodes;
+            for (BasicNode::id_t id : s.node_grid.QueryRect(view_a, view_b))
+            {
+                const NodeStorage *node = circuit.FindNodeIfExists(id);
+                if (!node || !(*node)->LooksPowered())
+                    continue;
+
+                (*node)->RenderPoweredParts(s.window_offset - s.view_offset);
+
+                ivec2 half_extent = (*node)->GetVisualHalfExtent() + 1;
+                std::vector<const EdgeGrid::Edge *> edges = s.edge_grid.QueryRect((*node)->pos - half_extent, (*node)->pos + half_extent);
+                edges_over_powered_nodes.insert(edges_over_powered_nodes.end(), edges.begin(), edges.end());
+            }
+            std::sort(edges_over_powered_nodes.begin(), edges_over_powered_nodes.end());
+
+            // Render the powered node connections and the connections covered by the powered nodes on top of it (only those passing through the visible area)
+            constexpr int connection_cull_margin = 8; // Enough for the decorations at the ends of connections.
+            for (const EdgeGrid::Edge *edge : s.edge_grid.QueryRect(view_a - connection_cull_margin, view_b + connection_cull_margin))
             {
-                if (((node->pos - s.view_offset).abs() > s.window_size/2 + node->GetVisualHalfExtent()).any())
+                std::optional<EdgeGrid::ResolvedEdge> e = EdgeGrid::Resolve(circuit, *edge);
+                if (!e)
                     continue;
+                if (!e->src_point->is_powered && !std::binary_search(edges_over_powered_nodes.begin(), edges_over_powered_nodes.end(), edge))
+                    continue; // This connection is already in the cache, and nothing covers it.
 
-                node->Render(s.window_offset - s.view_offset);
+                BasicNode::DrawConnection(s.window_offset, e->src_node->pos + e->src_point->info->offset_to_node - s.view_offset, e->dst_node->pos + e->dst_point->info->offset_to_node - s.view_offset,
+                    e->is_inverted, e->src_point->is_powered != e->is_inverted, e->src_point->info->visual_radius + e->src_point->info->extra_out_visual_radius, e->dst_point->info->visual_radius);
             }
 
-            // Render node connections
-            for (const NodeStorage &node_ptr : circuit.nodes)
+            // Activity map overlay
+            if (s.show_activity_map)
             {
-                const BasicNode &dst_node = *node_ptr;
+                constexpr fvec3 color_cold(0,0.3,1), color_hot(1,0.15,0), color_dead(0.5);
+                constexpr float activity_scale = 4; // This many toggles per tick are shown as the hottest color.
 
-                int dst_point_count = dst_node.InPointCount();
-                for (int i = 0; i < dst_point_count; i++)
+                auto ActivityColor = [&](BasicNode::id_t id) -> fvec4
                 {
-                    const BasicNode::InPoint &dst_point = dst_node.GetInPoint(i);
+                    if (s.activity_map.NodeIsDead(id))
+                        return color_dead.to_vec4(0.6);
+                    float t = clamp_max(s.activity_map.NodeActivity(id) * activity_scale, 1);
+                    return mix(sqrt(t), color_cold, color_hot).to_vec4(0.3 + 0.4 * t);
+                };
 
-                    for (const BasicNode::InPointCon &in_con : dst_point.connections)
-                    {
-                        const BasicNode &src_node = *circuit.FindNodeOrThrow(in_con.ids.node);
-                        const BasicNode::OutPoint &src_point = src_node.GetOutPoint(in_con.ids.point);
+                for (BasicNode::id_t id : s.node_grid.QueryRect(view_a, view_b))
+                {
+                    const NodeStorage *node = circuit.FindNodeIfExists(id);
+                    if (!node)
+                        continue;
 
-                        BasicNode::DrawConnection(s.window_offset, src_node.pos + src_point.info->offset_to_node - s.view_offset, dst_node.pos + dst_point.info->offset_to_node - s.view_offset,
-                            in_con.is_inverted, src_point.is_powered ^ in_con.is_inverted, src_point.info->visual_radius + src_point.info->extra_out_visual_radius, dst_point.info->visual_radius);
-                    }
+                    fvec4 color = ActivityColor(id);
+                    ivec2 half_extent = (*node)->GetVisualHalfExtent() + 1;
+                    r.iquad(s.window_offset + (*node)->pos - s.view_offset - half_extent, half_extent * 2).color(color.to_vec3()).alpha(color.a);
+                }
+
+                for (const EdgeGrid::Edge *edge : s.edge_grid.QueryRect(view_a, view_b))
+                {
+                    std::optional<EdgeGrid::ResolvedEdge> e = EdgeGrid::Resolve(circuit, *edge);
+                    if (!e)
+                        continue;
+
+                    fvec4 color = ActivityColor(edge->src_node);
+                    fvec2 a = s.window_offset + e->src_node->pos + e->src_point->info->offset_to_node - s.view_offset + 0.5;
+                    fvec2 b = s.window_offset + e->dst_node->pos + e->dst_point->info->offset_to_node - s.view_offset + 0.5;
+                    if (a != b)
+                        Draw::Line(a, b, 1).color(color.to_vec3()).alpha(color.a);
                 }
             }
 
@@ -1195,6 +1603,17 @@ namespace Components
                 Draw::RectFrame(s.window_offset + node.pos - s.view_offset - half_extent+1, half_extent*2-1, 1, true, fvec3(31,240,255)/255, 143/255.f);
             }
 
+            // Indicators on probed points
+            for (const Probes::Probe &probe : s.probes.GetProbes())
+            {
+                const NodeStorage *node = circuit.FindNodeIfExists(probe.node);
+                if (!node || probe.point >= (*node)->OutPointCount())
+                    continue;
+
+                ivec2 point_pos = (*node)->pos + (*node)->GetOutPoint(probe.point).info->offset_to_node;
+                Draw::RectFrame(s.window_offset + point_pos - s.view_offset - 2, ivec2(5), 1, true, fvec3(1,220/255.f,0), 0.8);
+            }
+
             // Indicator on a hovered node
             if (s.game_state == GameState::stopped && s.hovering_over_node_index != size_t(-1) && !s.now_creating_rect_selection
                 && !s.now_dragging_selected_nodes && (!s.eraser_mode || mouse.left.up() || !s.now_erasing_connections_instead_of_nodes))
@@ -1234,13 +1653,13 @@ namespace Components
         }
 
         // Active node or tool
-        if (s.partially_extended && s.mouse_in_window)
+        if (s.partially_extended && s.mouse_in_window && s.zoom_level == 0)
         {
             // A node
             if (s.held_node)
             {
                 // The node itself
-                s.held_node->Render(mouse.pos() + s.frame_offset);
+                s.held_node->Render(mouse.pos() + s.frame_offset, false);
 
                 // And indicator
                 r.iquad(s.frame_offset + mouse.pos() + ivec2(5), s.atlas.cursor.region(ivec2(16,0), ivec2(16))).center();
@@ -1,10 +1,14 @@
 #pragma once
 
+#include <cstddef>
 #include <memory>
 #include <optional>
 
+#include "game/components/breakpoints.h"
 #include "game/components/circuit.h"
 #include "game/components/menu_controller.h"
+#include "game/components/probes.h"
+#include "game/components/replay.h"
 #include "game/components/tooltip_controller.h"
 #include "game/components/world.h"
 
@@ -27,6 +31,15 @@ namespace Components
         enum class GameState {stopped, playing, paused, _count};
         GameState GetState() const;
 
+        // The controls of the last run, recorded since the world was last (re)started.
+        [[nodiscard]] const Replay &GetReplay() const;
+        // The probed 'out' points, which are recorded to `probes.vcd` while the world is running.
+        [[nodiscard]] const Probes &GetProbes() const;
+        // Conditions that pause the game after a tick. Press B over an 'out' point to break when it rises.
+        [[nodiscard]] Breakpoints &GetBreakpoints();
+        // Index of the breakpoint that fired on the last tick, or -1 if none.
+        [[nodiscard]] std::size_t LastFiredBreakpoint() const;
+
         void Tick(std::optional<World> &world, const std::optional<World> &saved_world, Circuit &circuit, MenuController &menu_controller, TooltipController &tooltip_controller);
         void Render(const Circuit &circuit) const;
         void RenderCursor() const;
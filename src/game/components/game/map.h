@@ -1,6 +1,8 @@
 #pragma once
 
 #include <exception>
+#include <map>
+#include <memory>
 #include <string>
 
 #include "game/main.h"
@@ -9,8 +11,6 @@
 #include "meta/misc.h"
 #include "program/errors.h"
 #include "reflection/full.h"
-#include "stream/readonly_data.h"
-#include "utils/json.h"
 #include "utils/multiarray.h"
 
 namespace Components::Game
@@ -35,8 +35,20 @@ namespace Components::Game
 
         using array_t = Array2D<Tile>;
 
+        // The immutable part of the map, loaded from a file.
+        // It's shared between all copies of a map, so copying a map (or a whole `World`) doesn't copy the tiles.
+        struct Level
+        {
+            array_t tiles;
+            Tiled::PointLayer point_layer;
+        };
+
       private:
-        array_t tiles;
+        std::shared_ptr<const Level> level;
+
+        // Per-map tile overrides, on top of `level->tiles`. The keys are tile indices in `level->tiles`.
+        // This is normally empty or small, and is copied along with the map.
+        std::map<std::ptrdiff_t, Tile> overlay;
 
         static const Graphics::TextureAtlas::Region &AtlasRegion()
         {
@@ -44,16 +56,28 @@ namespace Components::Game
             return ret;
         }
 
-        Tiled::PointLayer point_layer;
+        static const std::shared_ptr<const Level> &EmptyLevel()
+        {
+            static const std::shared_ptr<const Level> ret = std::make_shared<const Level>();
+            return ret;
+        }
+
+        [[nodiscard]] std::ptrdiff_t TileIndex(ivec2 pos) const
+        {
+            return pos.y * std::ptrdiff_t(level->tiles.size().x) + pos.x;
+        }
 
       public:
-        Map() {}
+        Map() : level(EmptyLevel()) {}
 
         Map(std::string file_name)
         {
             try
             {
-                Json json(Stream::ReadOnlyData(file_name).string(), 32);
+                auto new_level = std::make_shared<Level>();
+                array_t &tiles = new_level->tiles;
+
+                Tiled::Map map = Tiled::LoadMapCached(file_name, file_name + ".cache");
 
                 // Load tile layers
                 Meta::cexpr_for<Refl::Class::member_count<Tile>>([&](auto index)
@@ -62,11 +86,10 @@ namespace Components::Game
                     {
                         constexpr auto i = index.value;
 
-                        Json::View layer_json = Tiled::FindLayer(json.GetView(), Refl::Class::MemberName<Tile>(i));
-                        if (!layer_json)
+                        const Tiled::TileLayer *layer_ptr = map.FindTileLayer(Refl::Class::MemberName<Tile>(i));
+                        if (!layer_ptr)
                             Program::Error("Layer not found.");
-
-                        Tiled::TileLayer layer = Tiled::LoadTileLayer(layer_json);
+                        const Tiled::TileLayer &layer = *layer_ptr;
 
                         if constexpr (i == 0)
                         {
@@ -99,10 +122,12 @@ namespace Components::Game
                     tiles.unsafe_at(pos).random = rng.integer();
 
                 // Load points
-                auto point_layer_view = Tiled::FindLayer(json.GetView(), "objects");
-                if (!point_layer_view)
+                const Tiled::PointLayer *point_layer = map.FindPointLayer("objects");
+                if (!point_layer)
                     Program::Error("The `objects` layer is missing.");
-                point_layer = Tiled::LoadPointLayer(point_layer_view);
+                new_level->point_layer = *point_layer;
+
+                level = std::move(new_level);
             }
             catch (std::exception &e)
             {
@@ -110,14 +135,54 @@ namespace Components::Game
             }
         }
 
-        [[nodiscard]] const array_t &Tiles() const
+        // Returns the shared immutable level data. Tile overrides are not included.
+        [[nodiscard]] const std::shared_ptr<const Level> &GetLevel() const
         {
-            return tiles;
+            return level;
+        }
+
+        // Returns the map size in tiles.
+        [[nodiscard]] ivec2 Size() const
+        {
+            return level->tiles.size();
+        }
+
+        // Returns the tile at the specified position, respecting the overrides. Returns a default tile if out of range.
+        [[nodiscard]] Tile GetTile(ivec2 pos) const
+        {
+            if (!level->tiles.pos_in_range(pos))
+                return {};
+            if (!overlay.empty())
+            {
+                auto it = overlay.find(TileIndex(pos));
+                if (it != overlay.end())
+                    return it->second;
+            }
+            return level->tiles.unsafe_at(pos);
+        }
+
+        // Overrides a tile for this map only. The shared level data is not modified.
+        void SetTile(ivec2 pos, Tile tile)
+        {
+            if (!level->tiles.pos_in_range(pos))
+                Program::Error("Tile position ", pos, " is out of range.");
+
+            const Tile &original = level->tiles.unsafe_at(pos);
+            if (original.mid == tile.mid && original.random == tile.random)
+                overlay.erase(TileIndex(pos));
+            else
+                overlay.insert_or_assign(TileIndex(pos), tile);
+        }
+
+        // Removes all tile overrides.
+        void ResetTiles()
+        {
+            overlay.clear();
         }
 
         [[nodiscard]] const Tiled::PointLayer &Points() const
         {
-            return point_layer;
+            return level->point_layer;
         }
 
         template <int LayerIndex>
@@ -135,13 +200,13 @@ namespace Components::Game
             {
                 ivec2 pixel_pos = pos * tile_size - camera_pos;
 
-                auto tile_stack = tiles.try_get(pos);
+                Tile tile_stack = GetTile(pos);
                 TileType tile = Refl::Class::Member<LayerIndex>(tile_stack);
                 unsigned char random = tile_stack.random;
 
                 auto SameAs = [&](ivec2 offset, std::initializer_list<TileType> list = {})
                 {
-                    TileType this_tile = Refl::Class::Member<LayerIndex>(tiles.try_get(pos + offset));
+                    TileType this_tile = Refl::Class::Member<LayerIndex>(GetTile(pos + offset));
                     if (list.size() == 0)
                         return this_tile == tile;
                     else
@@ -252,15 +317,11 @@ namespace Components::Game
 
         [[nodiscard]] bool TileIsSolid(ivec2 pos) const
         {
-            if (!tiles.pos_in_range(pos))
-                return false;
-            return EnumIsSolid(tiles.unsafe_at(pos).mid);
+            return EnumIsSolid(GetTile(pos).mid);
         }
         [[nodiscard]] bool TileIsSpike(ivec2 pos) const
         {
-            if (!tiles.pos_in_range(pos))
-                return false;
-            return EnumIsSpike(tiles.unsafe_at(pos).mid);
+            return EnumIsSpike(GetTile(pos).mid);
         }
 
         [[nodiscard]] bool PixelIsSolid(ivec2 pixel) const
@@ -0,0 +1,191 @@
+#include "minimap_image.h"
+
+#include <algorithm>
+#include <utility>
+
+namespace Components
+{
+    MinimapImage::MinimapImage(ivec2 area_pos, ivec2 area_size)
+        : area_pos(area_pos), size(max(div_ex(area_size + cell_size - 1, cell_size), 1))
+    {
+        cells.resize(size.prod());
+        image = Graphics::Image(size);
+        dirty_rows_end = size.y;
+    }
+
+    MinimapImage::Entry MinimapImage::MakeEntry(const BasicNode &node) const
+    {
+        ivec2 cell = clamp(div_ex(node.pos - area_pos, cell_size), 0, size - 1);
+
+        Entry ret;
+        ret.id = node.id;
+        ret.cell = cell.x + cell.y * size.x;
+        ret.powered = node.LooksPowered();
+        return ret;
+    }
+
+    void MinimapImage::AddEntry(const Entry &entry, int sign)
+    {
+        Cell &cell = cells[entry.cell];
+        cell.nodes += sign;
+        cell.powered_nodes += sign * entry.powered;
+        UpdatePixel(entry.cell);
+    }
+
+    void MinimapImage::UpdateEntry(Entry &entry, const BasicNode &node)
+    {
+        Entry new_entry = MakeEntry(node);
+        if (new_entry.cell == entry.cell && new_entry.powered == entry.powered)
+            return;
+
+        AddEntry(entry, -1);
+        entry = new_entry;
+        AddEntry(entry, 1);
+    }
+
+    void MinimapImage::UpdatePixel(std::uint32_t cell_index)
+    {
+        constexpr fvec3 color_unpowered = fvec3(10,141,255)/255, color_powered = fvec3(255,230,150)/255;
+        constexpr int dense_node_count = 4; // If a cell has this many nodes, it gets the max opacity.
+        constexpr float min_alpha = 0.35;
+
+        const Cell &cell = cells[cell_index];
+        u8vec4 &pixel = image.UnsafeAt(ivec2(cell_index % size.x, cell_index / size.x));
+
+        if (cell.nodes == 0)
+        {
+            pixel = u8vec4(0);
+        }
+        else
+        {
+            float density = std::min(cell.nodes / float(dense_node_count), 1.f);
+            fvec3 color = mix(cell.powered_nodes / float(cell.nodes), color_unpowered, color_powered);
+            pixel = u8vec4(iround(color.to_vec4(mix(density, min_alpha, 1.f)) * 255));
+        }
+
+        int row = cell_index / size.x;
+        if (dirty_rows_begin == dirty_rows_end)
+        {
+            dirty_rows_begin = row;
+            dirty_rows_end = row + 1;
+        }
+        else
+        {
+            dirty_rows_begin = std::min(dirty_rows_begin, row);
+            dirty_rows_end = std::max(dirty_rows_end, row + 1);
+        }
+    }
+
+    void MinimapImage::SyncWithCircuit(const Circuit &circuit)
+    {
+        // Both the entries and the nodes are sorted by id, so they're matched in a single pass.
+        std::vector<Entry> new_entries;
+        new_entries.reserve(circuit.nodes.size());
+
+        auto old = entries.begin();
+        for (const NodeStorage &node : circuit.nodes)
+        {
+            // Those nodes were deleted.
+            while (old != entries.end() && old->id < node->id)
+                AddEntry(*old++, -1);
+
+            if (old != entries.end() && old->id == node->id)
+            {
+                Entry &entry = new_entries.emplace_back(*old++);
+                if (dirty_nodes.contains(node->id))
+                    UpdateEntry(entry, *node);
+            }
+            else
+            {
+                AddEntry(new_entries.emplace_back(MakeEntry(*node)), 1);
+            }
+        }
+        while (old != entries.end())
+            AddEntry(*old++, -1);
+
+        entries = std::move(new_entries);
+    }
+
+    void MinimapImage::Rebuild(const Circuit &circuit)
+    {
+        std::fill(cells.begin(), cells.end(), Cell{});
+        entries.clear();
+        entries.reserve(circuit.nodes.size());
+
+        for (const NodeStorage &node : circuit.nodes)
+        {
+            Entry &entry = entries.emplace_back(MakeEntry(*node));
+            cells[entry.cell].nodes++;
+            cells[entry.cell].powered_nodes += entry.powered;
+        }
+
+        for (std::uint32_t i = 0; i < cells.size(); i++)
+            UpdatePixel(i);
+    }
+
+    void MinimapImage::MarkNodeDirty(BasicNode::id_t id)
+    {
+        dirty_nodes.insert(id);
+    }
+
+    void MinimapImage::AddTick(const Circuit &circuit)
+    {
+        Update(circuit);
+
+        for (std::size_t i = 0; i < entries.size(); i++)
+        {
+            Entry &entry = entries[i];
+            bool powered = circuit.nodes[i]->LooksPowered();
+            if (powered == entry.powered)
+                continue;
+
+            entry.powered = powered;
+            cells[entry.cell].powered_nodes += powered ? 1 : -1;
+            UpdatePixel(entry.cell);
+        }
+    }
+
+    void MinimapImage::Update(const Circuit &circuit)
+    {
+        if (cells.empty())
+            return;
+
+        if (circuit.Generation() != synced_generation)
+        {
+            if (dirty_nodes.empty())
+                Rebuild(circuit); // The circuit was replaced behind our back.
+            else
+                SyncWithCircuit(circuit);
+        }
+        else
+        {
+            // Most likely no nodes were added or removed, so the indices match.
+            for (BasicNode::id_t id : dirty_nodes)
+            {
+                const NodeStorage *node = circuit.FindNodeIfExists(id);
+                if (!node)
+                    continue;
+                std::size_t index = node - circuit.nodes.data();
+                if (index >= entries.size() || entries[index].id != id)
+                {
+                    SyncWithCircuit(circuit);
+                    break;
+                }
+                UpdateEntry(entries[index], **node);
+            }
+        }
+        dirty_nodes.clear();
+        synced_generation = circuit.Generation();
+
+        if (!texture.Object())
+        {
+            texture = Graphics::Texture(nullptr).Wrap(Graphics::clamp).Interpolation(Graphics::linear).SetData(image);
+            dirty_rows_begin = dirty_rows_end = 0;
+        }
+        else if (dirty_rows_begin != dirty_rows_end)
+        {
+            texture.SetDataPart(ivec2(0, dirty_rows_begin), ivec2(size.x, dirty_rows_end - dirty_rows_begin), image.Data() + dirty_rows_begin * size.x * sizeof(u8vec4));
+            dirty_rows_begin = dirty_rows_end = 0;
+        }
+    }
+}
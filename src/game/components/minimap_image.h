@@ -0,0 +1,78 @@
+#pragma once
+
+#include <cstdint>
+#include <unordered_set>
+#include <vector>
+
+#include "game/components/circuit.h"
+#include "graphics/image.h"
+#include "graphics/texture.h"
+#include "utils/mat.h"
+
+namespace Components
+{
+    // A low resolution picture of the circuit for the editor minimap.
+    // Each pixel covers a square cell, and shows how many nodes are in it and how many of them look powered.
+    //
+    // Nothing is recomputed from scratch unless the circuit was replaced:
+    // call `MarkNodeDirty()` for every node that was moved, created, or deleted, and `AddTick()` after each circuit tick.
+    // Only the pixels of the changed cells are redrawn and uploaded.
+    class MinimapImage
+    {
+      public:
+        static constexpr int cell_size = 16;
+
+      private:
+        struct Cell
+        {
+            std::uint32_t nodes = 0;
+            std::uint32_t powered_nodes = 0;
+        };
+
+        struct Entry
+        {
+            BasicNode::id_t id = 0;
+            std::uint32_t cell = 0; // An index in `cells`.
+            bool powered = false;
+        };
+
+        ivec2 area_pos{}; // The top-left corner of the first cell, in circuit coordinates.
+        ivec2 size{}; // In cells.
+
+        std::vector<Cell> cells; // Parallel to the pixels of `image`.
+        std::vector<Entry> entries; // Parallel to `Circuit::nodes`, and sorted by id the same way.
+        std::unordered_set<BasicNode::id_t> dirty_nodes;
+        std::uint64_t synced_generation = 0; // `Circuit::Generation()` as of the last `Update()`, used to detect added and removed nodes.
+
+        Graphics::Image image;
+        Graphics::Texture texture; // Created by the first `Update()`.
+        int dirty_rows_begin = 0, dirty_rows_end = 0; // The rows of `image` that weren't uploaded yet.
+
+        [[nodiscard]] Entry MakeEntry(const BasicNode &node) const;
+        void AddEntry(const Entry &entry, int sign); // Adds the entry to its cell if `sign == 1`, or removes it if `sign == -1`.
+        void UpdateEntry(Entry &entry, const BasicNode &node);
+        void UpdatePixel(std::uint32_t cell);
+
+        // Matches `entries` to the current nodes by id, keeping the entries of the nodes that are not dirty.
+        void SyncWithCircuit(const Circuit &circuit);
+        // Recalculates everything, for when the circuit was replaced without marking the nodes as dirty.
+        void Rebuild(const Circuit &circuit);
+
+      public:
+        MinimapImage() {}
+        // The rectangle is in circuit coordinates. The nodes outside of it are shown at the nearest edge.
+        MinimapImage(ivec2 area_pos, ivec2 area_size);
+
+        void MarkNodeDirty(BasicNode::id_t id);
+
+        // Applies the node changes, then updates the powered state of all nodes.
+        // Per node this costs one `LooksPowered()` call and a comparison, only the nodes that changed touch their cells.
+        void AddTick(const Circuit &circuit);
+
+        // Applies the node changes, and uploads the changed pixels to the texture.
+        void Update(const Circuit &circuit);
+
+        // The texture as of the last `Update()`. Empty pixels are transparent.
+        [[nodiscard]] const Graphics::Texture &GetTexture() const {return texture;}
+    };
+}
@@ -0,0 +1,112 @@
+#include "node_clipboard.h"
+
+#include <algorithm>
+#include <exception>
+#include <limits>
+
+#include "stream/readonly_data.h"
+
+namespace Components
+{
+    std::vector<unsigned char> NodeClipboard::Copy(const Circuit &circuit, std::vector<BasicNode::id_t> ids)
+    {
+        std::sort(ids.begin(), ids.end());
+        ids.erase(std::unique(ids.begin(), ids.end()), ids.end());
+
+        // Returns the index of the node in `ids`, or -1 if it's not copied.
+        auto RelativeId = [&](BasicNode::id_t id) -> BasicNode::id_t
+        {
+            auto it = std::lower_bound(ids.begin(), ids.end(), id);
+            return it != ids.end() && *it == id ? BasicNode::id_t(it - ids.begin()) : BasicNode::id_t(-1);
+        };
+
+        Data data;
+        data.nodes.reserve(ids.size());
+
+        ivec2 bounds_a(std::numeric_limits<int>::max()), bounds_b(std::numeric_limits<int>::min());
+        for (BasicNode::id_t id : ids)
+        {
+            const NodeStorage &node = circuit.FindNodeOrThrow(id);
+            bounds_a = min(bounds_a, node->pos);
+            bounds_b = max(bounds_b, node->pos);
+            data.nodes.push_back(node);
+        }
+        ivec2 center = div_ex(bounds_a + bounds_b, 2);
+
+        for (BasicNode::id_t i = 0; i < data.nodes.size(); i++)
+        {
+            BasicNode &node = *data.nodes[i];
+            node.id = i;
+            node.pos -= center;
+
+            for (int j = 0, count = node.InPointCount(); j < count; j++)
+            {
+                std::vector<BasicNode::InPointCon> &cons = node.GetInPoint(j).connections;
+                for (BasicNode::InPointCon &con : cons)
+                    con.ids.node = RelativeId(con.ids.node);
+                std::erase_if(cons, [](const BasicNode::InPointCon &con){return con.ids.node == BasicNode::id_t(-1);});
+            }
+            for (int j = 0, count = node.OutPointCount(); j < count; j++)
+            {
+                std::vector<BasicNode::OutPointCon> &cons = node.GetOutPoint(j).connections;
+                for (BasicNode::OutPointCon &con : cons)
+                    con.ids.node = RelativeId(con.ids.node);
+                std::erase_if(cons, [](const BasicNode::OutPointCon &con){return con.ids.node == BasicNode::id_t(-1);});
+            }
+        }
+
+        return Refl::ToBinary<std::vector<unsigned char>>(data);
+    }
+
+    NodeClipboard::Data NodeClipboard::Load(const std::vector<unsigned char> &blob)
+    {
+        Data ret;
+        try
+        {
+            Refl::FromBinary(ret, Stream::ReadOnlyData::mem_reference(blob));
+            if (ret.version != current_version)
+                Program::Error("Unsupported clipboard version ", ret.version, ", expected ", current_version, ".");
+
+            for (std::size_t i = 0; i < ret.nodes.size(); i++)
+            {
+                if (ret.nodes[i]->id != i)
+                    Program::Error("Node ", i, " has a wrong id: ", ret.nodes[i]->id, ".");
+            }
+            Circuit::ValidateNodes(ret.nodes);
+        }
+        catch (std::exception &e)
+        {
+            Program::Error("While pasting nodes:\n", e.what());
+        }
+        return ret;
+    }
+
+    std::vector<BasicNode::id_t> NodeClipboard::Paste(Circuit::Batch &batch, const Data &data, ivec2 pos)
+    {
+        BasicNode::id_t base_id = batch.NextNodeId();
+
+        std::vector<BasicNode::id_t> ret;
+        ret.reserve(data.nodes.size());
+
+        for (const NodeStorage &source_node : data.nodes)
+        {
+            NodeStorage node = source_node;
+            node->pos += pos;
+
+            for (int j = 0, count = node->InPointCount(); j < count; j++)
+            {
+                for (BasicNode::InPointCon &con : node->GetInPoint(j).connections)
+                    con.ids.node += base_id;
+            }
+            for (int j = 0, count = node->OutPointCount(); j < count; j++)
+            {
+                for (BasicNode::OutPointCon &con : node->GetOutPoint(j).connections)
+                    con.ids.node += base_id;
+            }
+
+            ret.push_back(batch.AddNode(std::move(node)));
+        }
+
+        return ret;
+    }
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "game/components/circuit.h"
+#include "reflection/full_with_poly.h"
+#include "reflection/short_macros.h"
+#include "utils/mat.h"
+
+namespace Components
+{
+    // Copying and pasting parts of a circuit.
+    // The copied nodes are stored as a binary blob. Their ids are replaced with their indices in the blob,
+    // their positions are relative to the center of their bounding box, and only the connections between the copied nodes are kept.
+    class NodeClipboard
+    {
+      public:
+        static constexpr std::uint32_t current_version = 1;
+
+        SIMPLE_STRUCT( Data
+            DECL(std::uint32_t INIT=current_version) version
+            DECL(std::vector<NodeStorage>) nodes // The ids are the indices in this vector.
+        )
+
+        // Serializes the nodes. Throws if an id is missing from the circuit.
+        [[nodiscard]] static std::vector<unsigned char> Copy(const Circuit &circuit, std::vector<BasicNode::id_t> ids);
+
+        // Deserializes and validates the nodes. Throws on failure.
+        [[nodiscard]] static Data Load(const std::vector<unsigned char> &blob);
+
+        // Adds the nodes to the batch, centered at `pos`, and returns their new ids.
+        // The ids are remapped in a single pass, since the batch assigns consecutive ids to the new nodes.
+        static std::vector<BasicNode::id_t> Paste(Circuit::Batch &batch, const Data &data, ivec2 pos);
+    };
+}
@@ -0,0 +1,127 @@
+#include "node_grid.h"
+
+#include <algorithm>
+
+namespace Components
+{
+    std::uint64_t NodeGrid::CellKey(ivec2 cell)
+    {
+        return std::uint64_t(std::uint32_t(cell.x)) << 32 | std::uint32_t(cell.y);
+    }
+
+    ivec2 NodeGrid::PixelToCell(ivec2 pixel)
+    {
+        return div_ex(pixel, cell_size);
+    }
+
+    void NodeGrid::RememberCircuitGeneration(const Circuit &circuit)
+    {
+        synced_generation = circuit.Generation();
+    }
+
+    void NodeGrid::Rebuild(const Circuit &circuit)
+    {
+        entries.clear();
+        cells.clear();
+
+        for (const NodeStorage &node : circuit.nodes)
+        {
+            Entry &entry = entries[node->id];
+            entry.bounds_a = NodeBoundsA(*node);
+            entry.bounds_b = NodeBoundsB(*node);
+            ForEachCell(entry.bounds_a, entry.bounds_b, [&](ivec2 cell){cells[CellKey(cell)].push_back(node->id);});
+        }
+
+        RememberCircuitGeneration(circuit);
+    }
+
+    void NodeGrid::RebuildIfOutdated(const Circuit &circuit)
+    {
+        if (circuit.Generation() != synced_generation)
+        {
+            Rebuild(circuit);
+        }
+    }
+
+    void NodeGrid::AddNode(const Circuit &circuit, const BasicNode &node)
+    {
+        Entry &entry = entries[node.id];
+        entry.bounds_a = NodeBoundsA(node);
+        entry.bounds_b = NodeBoundsB(node);
+        ForEachCell(entry.bounds_a, entry.bounds_b, [&](ivec2 cell){cells[CellKey(cell)].push_back(node.id);});
+
+        RememberCircuitGeneration(circuit);
+    }
+
+    void NodeGrid::RemoveNode(const Circuit &circuit, BasicNode::id_t id)
+    {
+        auto it = entries.find(id);
+        if (it != entries.end())
+        {
+            ForEachCell(it->second.bounds_a, it->second.bounds_b, [&](ivec2 cell)
+            {
+                auto cell_it = cells.find(CellKey(cell));
+                if (cell_it == cells.end())
+                    return;
+                std::erase(cell_it->second, id);
+                if (cell_it->second.empty())
+                    cells.erase(cell_it);
+            });
+            entries.erase(it);
+        }
+
+        RememberCircuitGeneration(circuit);
+    }
+
+    void NodeGrid::MoveNode(const BasicNode &node)
+    {
+        auto it = entries.find(node.id);
+        if (it == entries.end())
+            return;
+
+        Entry &entry = it->second;
+        ivec2 new_a = NodeBoundsA(node), new_b = NodeBoundsB(node);
+
+        // Only touch the cells if the covered cell range has changed.
+        if (PixelToCell(new_a) != PixelToCell(entry.bounds_a) || PixelToCell(new_b) != PixelToCell(entry.bounds_b))
+        {
+            ForEachCell(entry.bounds_a, entry.bounds_b, [&](ivec2 cell)
+            {
+                auto cell_it = cells.find(CellKey(cell));
+                if (cell_it == cells.end())
+                    return;
+                std::erase(cell_it->second, node.id);
+                if (cell_it->second.empty())
+                    cells.erase(cell_it);
+            });
+            ForEachCell(new_a, new_b, [&](ivec2 cell){cells[CellKey(cell)].push_back(node.id);});
+        }
+
+        entry.bounds_a = new_a;
+        entry.bounds_b = new_b;
+    }
+
+    std::vector<BasicNode::id_t> NodeGrid::QueryRect(ivec2 a, ivec2 b) const
+    {
+        std::vector<BasicNode::id_t> ret;
+
+        ForEachCell(a, b, [&](ivec2 cell)
+        {
+            auto cell_it = cells.find(CellKey(cell));
+            if (cell_it == cells.end())
+                return;
+
+            for (BasicNode::id_t id : cell_it->second)
+            {
+                const Entry &entry = entries.at(id);
+                if ((entry.bounds_a <= b).all() && (entry.bounds_b >= a).all())
+                    ret.push_back(id);
+            }
+        });
+
+        // Nodes spanning several cells are found more than once.
+        std::sort(ret.begin(), ret.end());
+        ret.erase(std::unique(ret.begin(), ret.end()), ret.end());
+        return ret;
+    }
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+#include "game/components/circuit.h"
+#include "utils/mat.h"
+
+namespace Components
+{
+    // A uniform grid over the node bounds (`pos` +- `GetVisualHalfExtent()`), for fast hit-testing in the editor.
+    // Nodes are referred to by ids, since the indices in `Circuit::nodes` shift when nodes are removed.
+    // The grid must be updated on each node creation, move and deletion.
+    class NodeGrid
+    {
+      public:
+        static constexpr int cell_size = 32;
+
+      private:
+        struct Entry
+        {
+            ivec2 bounds_a, bounds_b; // Inclusive, in pixels.
+        };
+
+        std::unordered_map<BasicNode::id_t, Entry> entries;
+        std::unordered_map<std::uint64_t, std::vector<BasicNode::id_t>> cells;
+
+        // `Circuit::Generation()` as of the last sync, used to detect circuit changes that bypassed the grid.
+        std::uint64_t synced_generation = 0;
+
+        [[nodiscard]] static std::uint64_t CellKey(ivec2 cell);
+        [[nodiscard]] static ivec2 PixelToCell(ivec2 pixel);
+
+        template <typename F>
+        void ForEachCell(ivec2 a, ivec2 b, F &&func) const // `func` is `void func(ivec2 cell)`. `a` and `b` are inclusive, in pixels.
+        {
+            ivec2 cell_a = PixelToCell(a), cell_b = PixelToCell(b);
+            for (ivec2 cell = cell_a; cell.y <= cell_b.y; cell.y++)
+            for (cell.x = cell_a.x; cell.x <= cell_b.x; cell.x++)
+                func(cell);
+        }
+
+        void RememberCircuitGeneration(const Circuit &circuit);
+
+      public:
+        NodeGrid() {}
+
+        [[nodiscard]] static ivec2 NodeBoundsA(const BasicNode &node) {return node.pos - node.GetVisualHalfExtent();}
+        [[nodiscard]] static ivec2 NodeBoundsB(const BasicNode &node) {return node.pos + node.GetVisualHalfExtent();}
+
+        // Rebuilds the grid from scratch.
+        void Rebuild(const Circuit &circuit);
+        // Rebuilds the grid if the circuit was obviously changed without updating the grid (e.g. loaded from a file).
+        void RebuildIfOutdated(const Circuit &circuit);
+
+        // Those must be called after the corresponding change to `circuit`.
+        void AddNode(const Circuit &circuit, const BasicNode &node);
+        void RemoveNode(const Circuit &circuit, BasicNode::id_t id);
+        void MoveNode(const BasicNode &node);
+
+        // Returns ids of the nodes whose bounds might intersect the rectangle. `a` and `b` are inclusive.
+        // The ids are sorted, so they match the order in `Circuit::nodes`.
+        [[nodiscard]] std::vector<BasicNode::id_t> QueryRect(ivec2 a, ivec2 b) const;
+    };
+}
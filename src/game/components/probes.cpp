@@ -0,0 +1,285 @@
+#include "probes.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <thread>
+
+#include "program/errors.h"
+#include "stream/output.h"
+#include "utils/spsc_queue.h"
+
+namespace Components
+{
+    struct Probes::Recording
+    {
+        struct Change
+        {
+            std::uint32_t tick = 0;
+            std::uint32_t probe_index = 0;
+            bool value = false;
+        };
+
+        static constexpr std::size_t queue_capacity = 1 << 16;
+        static constexpr std::size_t backlog_capacity = 1 << 16;
+
+        // Those are only touched by the game thread.
+        std::vector<Probe> probes; // A copy of the probe list, made when the recording started.
+        std::vector<bool> last_values;
+        std::uint32_t tick = 0;
+        // The changes that didn't fit into the queue, with their original ticks. They are pushed before any newer changes, to keep the ticks ordered.
+        std::deque<Change> backlog;
+        std::size_t lost_changes = 0;
+
+        SpscQueue<Change> queue = SpscQueue<Change>(queue_capacity);
+        std::atomic<bool> stop_requested = false;
+        std::atomic<std::uint32_t> final_tick = 0;
+        std::atomic<bool> writer_done = false; // Set when the writer thread exits, either normally or because of an error.
+
+        std::string error; // Set by the writer thread on failure. Only read after the thread is joined.
+        std::thread thread;
+
+        Recording() {}
+        Recording(const Recording &) = delete;
+        Recording &operator=(const Recording &) = delete;
+
+        ~Recording()
+        {
+            if (thread.joinable())
+                Finish();
+        }
+
+        // Pushes as much of the backlog to the queue as possible.
+        void PushBacklog()
+        {
+            while (!backlog.empty() && queue.TryPush(backlog.front()))
+                backlog.pop_front();
+        }
+
+        // Makes the writer thread flush everything and exit, and waits for it.
+        void Finish()
+        {
+            while (true)
+            {
+                PushBacklog();
+                if (backlog.empty() || writer_done.load(std::memory_order_acquire))
+                    break;
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+
+            final_tick.store(tick, std::memory_order_relaxed);
+            stop_requested.store(true, std::memory_order_release);
+            thread.join();
+        }
+
+        // Returns a short printable VCD identifier for a variable index.
+        [[nodiscard]] static std::string VariableId(std::size_t index)
+        {
+            constexpr char first = '!', last = '~';
+            constexpr std::size_t base = last - first + 1;
+
+            std::string ret;
+            do
+            {
+                ret += char(first + index % base);
+                index /= base;
+            }
+            while (index > 0);
+            return ret;
+        }
+
+        [[nodiscard]] static std::string VariableName(const BasicNode *node, Probe probe)
+        {
+            std::string ret = node ? node->GetName() : "Node";
+            for (char &ch : ret)
+            {
+                if (!std::isalnum((unsigned char)ch))
+                    ch = '_';
+            }
+            return Str(ret, "_", probe.node, "_out", probe.point);
+        }
+
+        [[nodiscard]] static bool PointIsPowered(const Circuit &circuit, Probe probe)
+        {
+            const NodeStorage *node = circuit.FindNodeIfExists(probe.node);
+            return node && probe.point < (*node)->OutPointCount() && (*node)->GetOutPoint(probe.point).is_powered;
+        }
+
+        void WriterThread(Stream::Output output, std::vector<std::string> ids)
+        {
+            try
+            {
+                std::uint32_t cur_tick = 0;
+
+                while (true)
+                {
+                    // Check the flag before draining the queue, to make sure we don't miss the last changes.
+                    bool stopping = stop_requested.load(std::memory_order_acquire);
+
+                    bool got_any = false;
+                    Change change;
+                    while (queue.TryPop(change))
+                    {
+                        got_any = true;
+                        if (change.tick != cur_tick)
+                        {
+                            cur_tick = change.tick;
+                            output.WriteChar('#').WriteString(std::to_string(cur_tick)).WriteChar('\n');
+                        }
+                        output.WriteChar(change.value ? '1' : '0').WriteString(ids[change.probe_index]).WriteChar('\n');
+                    }
+
+                    if (stopping)
+                        break;
+
+                    if (!got_any)
+                        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+                }
+
+                // Mark the end of the recording, so that the last values extend to it.
+                std::uint32_t end = final_tick.load(std::memory_order_relaxed);
+                if (end != cur_tick)
+                    output.WriteChar('#').WriteString(std::to_string(end)).WriteChar('\n');
+
+                output.Flush();
+            }
+            catch (std::exception &e)
+            {
+                error = e.what();
+            }
+
+            writer_done.store(true, std::memory_order_release);
+        }
+    };
+
+    Probes::Probes() {}
+    Probes::Probes(Probes &&other) noexcept = default;
+    Probes &Probes::operator=(Probes &&other) noexcept = default;
+
+    Probes::~Probes() = default;
+
+    bool Probes::HasProbe(Probe probe) const
+    {
+        return std::find(probes.begin(), probes.end(), probe) != probes.end();
+    }
+
+    void Probes::ToggleProbe(Probe probe)
+    {
+        auto it = std::find(probes.begin(), probes.end(), probe);
+        if (it == probes.end())
+            probes.push_back(probe);
+        else
+            probes.erase(it);
+    }
+
+    void Probes::RemoveInvalidProbes(const Circuit &circuit)
+    {
+        std::erase_if(probes, [&](const Probe &probe)
+        {
+            const NodeStorage *node = circuit.FindNodeIfExists(probe.node);
+            return !node || probe.point >= (*node)->OutPointCount();
+        });
+    }
+
+    bool Probes::IsRecording() const
+    {
+        return bool(recording);
+    }
+
+    void Probes::StartRecording(const Circuit &circuit, std::string file_name)
+    {
+        StopRecording();
+
+        RemoveInvalidProbes(circuit);
+        if (probes.empty())
+            return;
+
+        auto new_recording = std::make_unique<Recording>();
+        new_recording->probes = probes;
+
+        Stream::Output output(file_name);
+
+        std::vector<std::string> ids;
+        ids.reserve(probes.size());
+
+        // The header and the initial values are written here, the thread only writes the changes.
+        output.WriteString("$comment circuit-bros probes, 1 time unit = 1 tick $end\n$timescale 1 ns $end\n$scope module circuit $end\n");
+        for (std::size_t i = 0; i < probes.size(); i++)
+        {
+            ids.push_back(Recording::VariableId(i));
+            const NodeStorage *node = circuit.FindNodeIfExists(probes[i].node);
+            output.WriteString(Str("$var wire 1 ", ids.back(), " ", Recording::VariableName(node ? &**node : nullptr, probes[i]), " $end\n"));
+        }
+        output.WriteString("$upscope $end\n$enddefinitions $end\n#0\n$dumpvars\n");
+        for (std::size_t i = 0; i < probes.size(); i++)
+        {
+            bool value = Recording::PointIsPowered(circuit, probes[i]);
+            new_recording->last_values.push_back(value);
+            output.WriteChar(value ? '1' : '0').WriteString(ids[i]).WriteChar('\n');
+        }
+        output.WriteString("$end\n");
+
+        Recording &rec = *new_recording;
+        rec.thread = std::thread([&rec, output = std::move(output), ids = std::move(ids)]() mutable
+        {
+            rec.WriterThread(std::move(output), std::move(ids));
+        });
+
+        recording = std::move(new_recording);
+    }
+
+    void Probes::StopRecording()
+    {
+        if (!recording)
+            return;
+
+        std::unique_ptr<Recording> rec = std::move(recording);
+        rec->Finish();
+
+        if (!rec->error.empty())
+            Program::Error("Unable to write the probe recording:\n", rec->error);
+    }
+
+    void Probes::AddTick(const Circuit &circuit)
+    {
+        if (!recording)
+            return;
+
+        Recording &rec = *recording;
+        rec.tick++;
+
+        rec.PushBacklog();
+
+        for (std::size_t i = 0; i < rec.probes.size(); i++)
+        {
+            bool value = Recording::PointIsPowered(circuit, rec.probes[i]);
+            if (value == rec.last_values[i])
+                continue;
+
+            Recording::Change change{.tick = rec.tick, .probe_index = std::uint32_t(i), .value = value};
+            if (rec.backlog.empty() && rec.queue.TryPush(change))
+            {
+                // Ok.
+            }
+            else if (rec.backlog.size() < Recording::backlog_capacity)
+            {
+                rec.backlog.push_back(change);
+            }
+            else
+            {
+                // The change is lost. We keep the old value, so the next change that fits records the actual state, but at a later tick.
+                rec.lost_changes++;
+                continue;
+            }
+            rec.last_values[i] = value;
+        }
+    }
+
+    std::size_t Probes::LostChangeCount() const
+    {
+        return recording ? recording->lost_changes : 0;
+    }
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "game/components/circuit.h"
+
+namespace Components
+{
+    // Watches a set of 'out' connection points, and streams their per-tick state changes to a VCD (Value Change Dump) file.
+    // The file is written by a background thread, the tick only pushes the changes to a lock-free queue.
+    class Probes
+    {
+        struct Recording;
+        std::unique_ptr<Recording> recording;
+
+      public:
+        struct Probe
+        {
+            BasicNode::id_t node = 0;
+            int point = 0; // Index of an 'out' point.
+
+            [[nodiscard]] friend bool operator==(const Probe &, const Probe &) = default;
+        };
+
+      private:
+        std::vector<Probe> probes;
+
+      public:
+        Probes();
+        Probes(Probes &&) noexcept;
+        Probes &operator=(Probes &&) noexcept;
+        ~Probes(); // Stops the recording, if any, ignoring errors.
+
+        [[nodiscard]] const std::vector<Probe> &GetProbes() const {return probes;}
+        [[nodiscard]] bool HasProbe(Probe probe) const;
+        // Adds the probe if it doesn't exist, otherwise removes it.
+        // The changes only affect the next recording.
+        void ToggleProbe(Probe probe);
+        // Removes probes that refer to nonexistent nodes or points.
+        void RemoveInvalidProbes(const Circuit &circuit);
+
+        [[nodiscard]] bool IsRecording() const;
+        // Starts recording to a file, stopping the previous recording if any. Does nothing if there are no probes.
+        // Writes the initial state of the probes.
+        void StartRecording(const Circuit &circuit, std::string file_name);
+        // Waits until everything is written to the file. Throws if the writer thread has failed.
+        void StopRecording();
+        // Call this after each circuit tick.
+        void AddTick(const Circuit &circuit);
+        // The amount of changes that weren't recorded because the writer thread couldn't keep up, so the file is inaccurate.
+        // Normally the changes are buffered until the thread catches up, this only happens if it falls behind too far.
+        [[nodiscard]] std::size_t LostChangeCount() const;
+    };
+}
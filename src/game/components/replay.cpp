@@ -0,0 +1,106 @@
+#include "replay.h"
+
+#include "program/errors.h"
+#include "stream/input.h"
+#include "stream/output.h"
+#include "utils/hash.h"
+
+namespace Components
+{
+    std::uint64_t Replay::StateHash(const World &world, const Circuit &circuit)
+    {
+        std::uint64_t ret = world.StateHash();
+        Hash::AppendBytes(ret, circuit.StateHash());
+        return ret;
+    }
+
+    void Replay::Start(World &world, const Circuit &circuit, int hash_period)
+    {
+        world.ResetCircuitInputs();
+
+        data = {};
+        data.level_name = world.GetLevelName();
+        data.seed = world.GetSeed();
+        data.circuit.nodes = circuit.nodes;
+        data.hash_period = hash_period;
+
+        is_recording = true;
+        tick_count = 0;
+    }
+
+    void Replay::Stop()
+    {
+        is_recording = false;
+    }
+
+    void Replay::AddTick(const World::Controls &controls, const World &world, const Circuit &circuit)
+    {
+        if (!is_recording)
+            return;
+
+        std::uint8_t bits = controls.ToBits();
+        if (data.controls.empty() || data.controls.back().controls != bits)
+            data.controls.push_back(ControlsRun{.controls = bits, .ticks = 0});
+        data.controls.back().ticks++;
+
+        tick_count++;
+        if (tick_count % data.hash_period == 0)
+            data.hashes.push_back(StateHash(world, circuit));
+    }
+
+    void Replay::Save(std::string file_name) const
+    {
+        Stream::Output output(file_name);
+        Refl::ToBinary(data, output);
+    }
+
+    Replay::Data Replay::Load(std::string file_name)
+    {
+        Data ret;
+        try
+        {
+            Refl::FromBinary(ret, Stream::Input(file_name));
+            if (ret.version != current_version)
+                Program::Error("Unsupported replay version ", ret.version, ", expected ", current_version, ".");
+            if (ret.hash_period <= 0)
+                Program::Error("Invalid hash period: ", ret.hash_period, ".");
+        }
+        catch (std::exception &e)
+        {
+            Program::Error("While loading replay `", file_name, "`:\n", e.what());
+        }
+        return ret;
+    }
+
+    Replay::VerificationResult Replay::Verify(const Data &data)
+    {
+        VerificationResult ret;
+
+        World world(data.level_name, data.seed);
+        Circuit circuit;
+        circuit.nodes = data.circuit.nodes;
+
+        for (const ControlsRun &run : data.controls)
+        {
+            World::Controls controls = World::Controls::FromBits(run.controls);
+
+            for (std::uint32_t i = 0; i < run.ticks; i++)
+            {
+                circuit.Tick(world);
+                world.Tick(controls);
+                ret.ticks++;
+
+                if (ret.ticks % data.hash_period == 0 && ret.hashes_checked < data.hashes.size())
+                {
+                    if (StateHash(world, circuit) != data.hashes[ret.hashes_checked++])
+                    {
+                        ret.first_mismatched_tick = ret.ticks;
+                        return ret;
+                    }
+                }
+            }
+        }
+
+        return ret;
+    }
+}
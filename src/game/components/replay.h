@@ -0,0 +1,79 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "game/components/circuit.h"
+#include "game/components/world.h"
+#include "reflection/full_with_poly.h"
+#include "reflection/short_macros.h"
+
+namespace Components
+{
+    // Records the keyboard controls that reach the world on each tick, along with periodic state hashes.
+    // A replay can then be re-run without rendering to check that the simulation is deterministic.
+    class Replay
+    {
+      public:
+        static constexpr std::uint32_t current_version = 2;
+        static constexpr int default_hash_period = 60;
+
+        SIMPLE_STRUCT( ControlsRun
+            DECL(std::uint8_t INIT=0) controls // See `World::Controls::ToBits()`.
+            DECL(std::uint32_t INIT=0) ticks
+        )
+
+        SIMPLE_STRUCT( Data
+            DECL(std::uint32_t INIT=current_version) version
+            DECL(std::string) level_name
+            DECL(World::seed_t INIT=0) seed
+            DECL(Circuit) circuit // The circuit at the beginning of the recording.
+            DECL(std::int32_t INIT=default_hash_period) hash_period
+            DECL(std::vector<ControlsRun>) controls // Run-length encoded controls.
+            DECL(std::vector<std::uint64_t>) hashes // A hash of the world and the circuit after every `hash_period` ticks.
+        )
+
+        struct VerificationResult
+        {
+            std::size_t ticks = 0; // The amount of ticks that were simulated.
+            std::size_t hashes_checked = 0;
+            std::size_t first_mismatched_tick = -1; // -1 if everything matches.
+
+            [[nodiscard]] bool Ok() const
+            {
+                return first_mismatched_tick == std::size_t(-1);
+            }
+        };
+
+      private:
+        Data data;
+        bool is_recording = false;
+        std::size_t tick_count = 0;
+
+      public:
+        Replay() {}
+
+        [[nodiscard]] const Data &GetData() const {return data;}
+        [[nodiscard]] bool IsRecording() const {return is_recording;}
+        [[nodiscard]] bool IsEmpty() const {return tick_count == 0;}
+        [[nodiscard]] std::size_t TickCount() const {return tick_count;}
+
+        [[nodiscard]] static std::uint64_t StateHash(const World &world, const Circuit &circuit);
+
+        // Starts a new recording, discarding the old one. Must be called before the first recorded tick.
+        // Resets the transient circuit inputs of the `world`, to make sure it matches a freshly constructed one.
+        void Start(World &world, const Circuit &circuit, int hash_period = default_hash_period);
+        // Stops recording. The recorded data is kept.
+        void Stop();
+        // Call this after each recorded tick.
+        void AddTick(const World::Controls &controls, const World &world, const Circuit &circuit);
+
+        void Save(std::string file_name) const;
+        [[nodiscard]] static Data Load(std::string file_name);
+
+        // Re-runs the recorded ticks without rendering, and compares the state hashes.
+        [[nodiscard]] static VerificationResult Verify(const Data &data);
+    };
+}
@@ -0,0 +1,322 @@
+#include "undo_history.h"
+
+#include <algorithm>
+#include <utility>
+
+#include "macros/finally.h"
+#include "reflection/full_with_poly.h"
+#include "stream/readonly_data.h"
+
+namespace Components
+{
+    std::size_t UndoHistory::OpBytes(const Op &op)
+    {
+        std::size_t ret = sizeof(Op);
+        if (auto node_op = std::get_if<NodeOp>(&op))
+            ret += node_op->data.capacity();
+        return ret;
+    }
+
+    std::vector<unsigned char> UndoHistory::SerializeWithoutConnections(const NodeStorage &node)
+    {
+        NodeStorage copy = node;
+        for (int i = 0, count = copy->InPointCount(); i < count; i++)
+            copy->GetInPoint(i).connections.clear();
+        for (int i = 0, count = copy->OutPointCount(); i < count; i++)
+            copy->GetOutPoint(i).connections.clear();
+        return Refl::ToBinary<std::vector<unsigned char>>(copy);
+    }
+
+    void UndoHistory::AddOp(Op op)
+    {
+        pending_step.bytes += OpBytes(op);
+        pending_step.ops.push_back(std::move(op));
+    }
+
+    void UndoHistory::RecordNodeConnections(const Circuit &circuit, const std::vector<BasicNode::id_t> &sorted_ids, bool exist_after)
+    {
+        auto AddConnection = [&](BasicNode::NodeAndPointId src, BasicNode::NodeAndPointId dst, ConnectionState state)
+        {
+            ConnectionOp op{.src = src, .dst = dst};
+            (exist_after ? op.after : op.before) = state;
+            AddOp(op);
+        };
+
+        for (BasicNode::id_t id : sorted_ids)
+        {
+            const BasicNode &node = *circuit.FindNodeOrThrow(id);
+
+            for (int i = 0, count = node.InPointCount(); i < count; i++)
+            {
+                for (const BasicNode::InPointCon &con : node.GetInPoint(i).connections)
+                    AddConnection(con.ids, {id, i}, con.is_inverted ? ConnectionState::inverted : ConnectionState::regular);
+            }
+
+            for (int i = 0, count = node.OutPointCount(); i < count; i++)
+            {
+                for (const BasicNode::OutPointCon &con : node.GetOutPoint(i).connections)
+                {
+                    // The connections to the listed nodes (including this one) are recorded from their 'in' points.
+                    if (std::binary_search(sorted_ids.begin(), sorted_ids.end(), con.ids.node))
+                        continue;
+                    AddConnection({id, i}, con.ids, GetConnectionState(circuit, {id, i}, con.ids));
+                }
+            }
+        }
+    }
+
+    void UndoHistory::EnforceMemoryBudget()
+    {
+        while (total_bytes > memory_budget && steps.size() > 1 && applied_steps > 0)
+        {
+            total_bytes -= steps.front().bytes;
+            steps.pop_front();
+            applied_steps--;
+        }
+    }
+
+    void UndoHistory::RememberCircuitGeneration(const Circuit &circuit)
+    {
+        synced_generation = circuit.Generation();
+    }
+
+    void UndoHistory::ApplyOp(Circuit &circuit, const Op &op, bool forward, std::vector<BasicNode::id_t> &changed_ids)
+    {
+        std::visit(Meta::overload{
+            [&](const NodeOp &node_op)
+            {
+                auto it = std::lower_bound(circuit.nodes.begin(), circuit.nodes.end(), node_op.id, [](const NodeStorage &node, BasicNode::id_t id){return node->id < id;});
+                bool exists = it != circuit.nodes.end() && (*it)->id == node_op.id;
+
+                if (node_op.exists_after == forward)
+                {
+                    if (exists)
+                        Program::Error("Undo: node ", node_op.id, " already exists.");
+                    NodeStorage node;
+                    Refl::FromBinary(node, Stream::ReadOnlyData::mem_reference(node_op.data));
+                    circuit.nodes.insert(it, std::move(node));
+                }
+                else
+                {
+                    if (!exists)
+                        Program::Error("Undo: node ", node_op.id, " doesn't exist.");
+                    circuit.nodes.erase(it);
+                }
+                circuit.MarkModified();
+
+                changed_ids.push_back(node_op.id);
+            },
+            [&](const MoveOp &move_op)
+            {
+                circuit.FindNodeOrThrow(move_op.id)->pos = forward ? move_op.to : move_op.from;
+                changed_ids.push_back(move_op.id);
+            },
+            [&](const ConnectionOp &con_op)
+            {
+                SetConnectionState(circuit, con_op.src, con_op.dst, forward ? con_op.after : con_op.before);
+                changed_ids.push_back(con_op.src.node);
+                changed_ids.push_back(con_op.dst.node);
+            },
+        }, op);
+    }
+
+    void UndoHistory::SetConnectionState(Circuit &circuit, BasicNode::NodeAndPointId src, BasicNode::NodeAndPointId dst, ConnectionState state)
+    {
+        BasicNode &src_node = *circuit.FindNodeOrThrow(src.node);
+        BasicNode &dst_node = *circuit.FindNodeOrThrow(dst.node);
+        if (src.point >= src_node.OutPointCount() || dst.point >= dst_node.InPointCount())
+            Program::Error("Undo: invalid connection point index.");
+
+        BasicNode::OutPoint &src_point = src_node.GetOutPoint(src.point);
+        BasicNode::InPoint &dst_point = dst_node.GetInPoint(dst.point);
+        std::erase_if(src_point.connections, [&](const BasicNode::OutPointCon &con){return con.ids == dst;});
+        std::erase_if(dst_point.connections, [&](const BasicNode::InPointCon &con){return con.ids == src;});
+
+        if (state != ConnectionState::none)
+        {
+            src_point.connections.push_back(BasicNode::OutPointCon(dst));
+            dst_point.connections.push_back(BasicNode::InPointCon(src, state == ConnectionState::inverted));
+        }
+    }
+
+    void UndoHistory::SetMemoryBudget(std::size_t bytes)
+    {
+        memory_budget = bytes;
+        EnforceMemoryBudget();
+    }
+
+    void UndoHistory::Clear()
+    {
+        steps.clear();
+        applied_steps = 0;
+        total_bytes = 0;
+        pending_step = {};
+        connection_snapshot.clear();
+    }
+
+    void UndoHistory::ClearIfOutdated(const Circuit &circuit)
+    {
+        if (circuit.Generation() != synced_generation)
+        {
+            Clear();
+            RememberCircuitGeneration(circuit);
+        }
+    }
+
+    UndoHistory::ConnectionState UndoHistory::GetConnectionState(const Circuit &circuit, BasicNode::NodeAndPointId src, BasicNode::NodeAndPointId dst)
+    {
+        const NodeStorage *dst_node = circuit.FindNodeIfExists(dst.node);
+        if (!dst_node || dst.point >= (*dst_node)->InPointCount())
+            return ConnectionState::none;
+
+        // The inverted-ness is only stored in the 'in' point.
+        for (const BasicNode::InPointCon &con : (*dst_node)->GetInPoint(dst.point).connections)
+        {
+            if (con.ids == src)
+                return con.is_inverted ? ConnectionState::inverted : ConnectionState::regular;
+        }
+        return ConnectionState::none;
+    }
+
+    void UndoHistory::RecordNodesCreated(const Circuit &circuit, std::vector<BasicNode::id_t> ids)
+    {
+        std::sort(ids.begin(), ids.end());
+        ids.erase(std::unique(ids.begin(), ids.end()), ids.end());
+
+        // When redoing, all nodes are created before the connections between them.
+        for (BasicNode::id_t id : ids)
+            AddOp(NodeOp{.id = id, .exists_after = true, .data = SerializeWithoutConnections(circuit.FindNodeOrThrow(id))});
+        RecordNodeConnections(circuit, ids, true);
+    }
+
+    void UndoHistory::RecordNodesDeleted(const Circuit &circuit, std::vector<BasicNode::id_t> ids)
+    {
+        std::sort(ids.begin(), ids.end());
+        ids.erase(std::unique(ids.begin(), ids.end()), ids.end());
+
+        // When undoing, all nodes are restored before the connections between them.
+        RecordNodeConnections(circuit, ids, false);
+        for (BasicNode::id_t id : ids)
+            AddOp(NodeOp{.id = id, .exists_after = false, .data = SerializeWithoutConnections(circuit.FindNodeOrThrow(id))});
+    }
+
+    void UndoHistory::RecordNodeMoved(BasicNode::id_t id, ivec2 from, ivec2 to)
+    {
+        if (from != to)
+            AddOp(MoveOp{.id = id, .from = from, .to = to});
+    }
+
+    void UndoHistory::BeginConnectionChange(const Circuit &circuit, const std::vector<BasicNode::id_t> &ids)
+    {
+        connection_snapshot.clear();
+        for (BasicNode::id_t id : ids)
+        {
+            if (std::any_of(connection_snapshot.begin(), connection_snapshot.end(), [&](const auto &elem){return elem.first == id;}))
+                continue;
+
+            const BasicNode &node = *circuit.FindNodeOrThrow(id);
+            auto &[snapshot_id, points] = connection_snapshot.emplace_back();
+            snapshot_id = id;
+            for (int i = 0, count = node.InPointCount(); i < count; i++)
+                points.push_back(node.GetInPoint(i).connections);
+        }
+    }
+
+    void UndoHistory::EndConnectionChange(const Circuit &circuit)
+    {
+        auto StateOf = [](const std::vector<BasicNode::InPointCon> &cons, BasicNode::NodeAndPointId src)
+        {
+            auto it = std::find_if(cons.begin(), cons.end(), [&](const BasicNode::InPointCon &con){return con.ids == src;});
+            if (it == cons.end())
+                return ConnectionState::none;
+            return it->is_inverted ? ConnectionState::inverted : ConnectionState::regular;
+        };
+
+        for (const auto &[id, old_points] : connection_snapshot)
+        {
+            const BasicNode &node = *circuit.FindNodeOrThrow(id);
+            for (int i = 0; i < int(old_points.size()); i++)
+            {
+                const std::vector<BasicNode::InPointCon> &old_cons = old_points[i];
+                const std::vector<BasicNode::InPointCon> &new_cons = node.GetInPoint(i).connections;
+
+                // The removed and changed connections.
+                for (const BasicNode::InPointCon &con : old_cons)
+                {
+                    ConnectionOp op{.src = con.ids, .dst = {id, i}, .before = StateOf(old_cons, con.ids), .after = StateOf(new_cons, con.ids)};
+                    if (op.before != op.after)
+                        AddOp(op);
+                }
+                // The added connections.
+                for (const BasicNode::InPointCon &con : new_cons)
+                {
+                    if (StateOf(old_cons, con.ids) == ConnectionState::none)
+                        AddOp(ConnectionOp{.src = con.ids, .dst = {id, i}, .after = StateOf(new_cons, con.ids)});
+                }
+            }
+        }
+
+        connection_snapshot.clear();
+    }
+
+    void UndoHistory::FinishStep(const Circuit &circuit)
+    {
+        if (pending_step.ops.empty())
+            return;
+
+        // Discard the steps that could be redone.
+        while (steps.size() > applied_steps)
+        {
+            total_bytes -= steps.back().bytes;
+            steps.pop_back();
+        }
+
+        pending_step.ops.shrink_to_fit();
+        total_bytes += pending_step.bytes;
+        steps.push_back(std::move(pending_step));
+        pending_step = {};
+        applied_steps++;
+
+        EnforceMemoryBudget();
+        RememberCircuitGeneration(circuit);
+    }
+
+    bool UndoHistory::Undo(Circuit &circuit, std::vector<BasicNode::id_t> &changed_ids)
+    {
+        changed_ids.clear();
+        if (!CanUndo())
+            return false;
+
+        // If the step can't be undone, the history doesn't match the circuit, and is useless.
+        FINALLY_ON_THROW( Clear(); )
+
+        const Step &step = steps[applied_steps - 1];
+        for (auto it = step.ops.rbegin(); it != step.ops.rend(); it++)
+            ApplyOp(circuit, *it, false, changed_ids);
+        applied_steps--;
+
+        std::sort(changed_ids.begin(), changed_ids.end());
+        changed_ids.erase(std::unique(changed_ids.begin(), changed_ids.end()), changed_ids.end());
+        RememberCircuitGeneration(circuit);
+        return true;
+    }
+
+    bool UndoHistory::Redo(Circuit &circuit, std::vector<BasicNode::id_t> &changed_ids)
+    {
+        changed_ids.clear();
+        if (!CanRedo())
+            return false;
+
+        FINALLY_ON_THROW( Clear(); )
+
+        const Step &step = steps[applied_steps];
+        for (const Op &op : step.ops)
+            ApplyOp(circuit, op, true, changed_ids);
+        applied_steps++;
+
+        std::sort(changed_ids.begin(), changed_ids.end());
+        changed_ids.erase(std::unique(changed_ids.begin(), changed_ids.end()), changed_ids.end());
+        RememberCircuitGeneration(circuit);
+        return true;
+    }
+}
@@ -0,0 +1,115 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <utility>
+#include <variant>
+#include <vector>
+
+#include "game/components/circuit.h"
+#include "utils/mat.h"
+
+namespace Components
+{
+    // The undo/redo history of the editor.
+    // Instead of circuit snapshots, it stores small reversible operations: node creation/deletion, moves, and connection changes.
+    // Undoing or redoing a step costs proportionally to the amount of operations in it, regardless of the circuit size.
+    //
+    // The operations of one user action are recorded with `Record...()`, then `FinishStep()` turns them into one undo step.
+    // Node creation and deletion are split into the connection changes and the creation or deletion of a node without connections,
+    // so the node data is never duplicated, and the connections are always restored after the nodes they connect.
+    class UndoHistory
+    {
+      public:
+        static constexpr std::size_t default_memory_budget = 16 * 1024 * 1024;
+
+        enum class ConnectionState : std::uint8_t {none, regular, inverted};
+
+      private:
+        struct NodeOp
+        {
+            BasicNode::id_t id = 0;
+            bool exists_after = false; // True for creation, false for deletion.
+            std::vector<unsigned char> data; // The serialized node, without connections.
+        };
+        struct MoveOp
+        {
+            BasicNode::id_t id = 0;
+            ivec2 from{}, to{};
+        };
+        struct ConnectionOp
+        {
+            BasicNode::NodeAndPointId src; // An 'out' point.
+            BasicNode::NodeAndPointId dst; // An 'in' point.
+            ConnectionState before = ConnectionState::none, after = ConnectionState::none;
+        };
+        using Op = std::variant<NodeOp, MoveOp, ConnectionOp>;
+
+        struct Step
+        {
+            std::vector<Op> ops;
+            std::size_t bytes = 0; // The approximate memory usage.
+        };
+
+        std::deque<Step> steps;
+        std::size_t applied_steps = 0; // The steps after this one can be redone.
+        std::size_t total_bytes = 0;
+        std::size_t memory_budget = default_memory_budget;
+
+        Step pending_step;
+
+        // The 'in' points of those nodes are remembered by `BeginConnectionChange()`.
+        std::vector<std::pair<BasicNode::id_t, std::vector<std::vector<BasicNode::InPointCon>>>> connection_snapshot;
+
+        // `Circuit::Generation()` as of the last sync, used to detect circuit changes that bypassed the history.
+        std::uint64_t synced_generation = 0;
+
+        [[nodiscard]] static std::size_t OpBytes(const Op &op);
+        [[nodiscard]] static std::vector<unsigned char> SerializeWithoutConnections(const NodeStorage &node);
+        void AddOp(Op op);
+        // Records the connections of the nodes as created or deleted. Each connection is recorded once, even if it's between two listed nodes.
+        void RecordNodeConnections(const Circuit &circuit, const std::vector<BasicNode::id_t> &sorted_ids, bool exist_after);
+        void EnforceMemoryBudget();
+        void RememberCircuitGeneration(const Circuit &circuit);
+
+        // Applies the operation in the specified direction. Adds the ids of the affected nodes to `changed_ids`.
+        static void ApplyOp(Circuit &circuit, const Op &op, bool forward, std::vector<BasicNode::id_t> &changed_ids);
+        static void SetConnectionState(Circuit &circuit, BasicNode::NodeAndPointId src, BasicNode::NodeAndPointId dst, ConnectionState state);
+
+      public:
+        UndoHistory() {}
+
+        // The oldest steps are discarded when this is exceeded. The newest step is always kept.
+        void SetMemoryBudget(std::size_t bytes);
+        [[nodiscard]] std::size_t MemoryUsage() const {return total_bytes;}
+
+        void Clear();
+        // Clears the history if the circuit was obviously changed behind our back (e.g. loaded from a file).
+        void ClearIfOutdated(const Circuit &circuit);
+
+        [[nodiscard]] bool CanUndo() const {return applied_steps > 0;}
+        [[nodiscard]] bool CanRedo() const {return applied_steps < steps.size();}
+
+        [[nodiscard]] static ConnectionState GetConnectionState(const Circuit &circuit, BasicNode::NodeAndPointId src, BasicNode::NodeAndPointId dst);
+
+        // Call this right after adding the nodes to the circuit.
+        void RecordNodesCreated(const Circuit &circuit, std::vector<BasicNode::id_t> ids);
+        // Call this right before removing the nodes from the circuit.
+        void RecordNodesDeleted(const Circuit &circuit, std::vector<BasicNode::id_t> ids);
+        void RecordNodeMoved(BasicNode::id_t id, ivec2 from, ivec2 to);
+        // Wrap any changes to the connections of the listed nodes in those two calls.
+        // Only the connections ending at the 'in' points of the listed nodes are checked for changes.
+        void BeginConnectionChange(const Circuit &circuit, const std::vector<BasicNode::id_t> &ids);
+        void EndConnectionChange(const Circuit &circuit);
+
+        // Turns the operations recorded since the last call into one undo step, and discards the steps that could be redone.
+        // Does nothing if nothing was recorded.
+        void FinishStep(const Circuit &circuit);
+
+        // Return false if there is nothing to undo or redo.
+        // The ids of all created, deleted, moved and reconnected nodes are written to `changed_ids`, sorted and without duplicates.
+        bool Undo(Circuit &circuit, std::vector<BasicNode::id_t> &changed_ids);
+        bool Redo(Circuit &circuit, std::vector<BasicNode::id_t> &changed_ids);
+    };
+}
@@ -4,6 +4,7 @@
 #include "game/components/game/map.h"
 
 #include "strings/format.h"
+#include "utils/hash.h"
 
 namespace Components
 {
@@ -22,6 +23,13 @@ namespace Components
             false;
         #endif
 
+        std::string level_name;
+        World::seed_t seed = 0;
+
+        // This shadows the global `rng` in the member functions, to keep the simulation deterministic.
+        // Don't use the global generator for anything that affects the simulation.
+        Random<> rng;
+
         Game::Map map;
 
         struct Player
@@ -114,7 +122,7 @@ namespace Components
             bool fire_trail = false;
             bool collision = false;
 
-            bool sprite_flip_x = rng.boolean();
+            bool sprite_flip_x = false;
         };
         std::deque<ScrapParticle> scrap_particles;
 
@@ -159,6 +167,18 @@ namespace Components
 
                 DECL(Input) in_control_left, in_control_right, in_control_jump
             )
+
+            void ResetInputsAtNextAssignment()
+            {
+                Meta::cexpr_for<Refl::Class::member_count<CircuitIO>>([&](auto index)
+                {
+                    constexpr auto i = index.value;
+                    if constexpr (std::is_same_v<Input, Refl::Class::member_type<CircuitIO, i>>)
+                    {
+                        Refl::Class::Member<i>(*this).ResetAtNextAssignment();
+                    }
+                });
+            }
         };
         CircuitIO circuit_io;
 
@@ -261,19 +281,22 @@ namespace Components
                     fvec2 vel = base_vel + dir * float(0.15 <= rng.real() <= 4.65);
 
                     scrap_particles.push_back(adjust(ScrapParticle{}, pos = pos, vel = vel, tex = atlas.player.region(ivec2(12 * i, 24), ivec2(12)),
-                                                     life = 160 <= rng.integer() <= 300, fire_trail = true, collision = int(0 <= rng.integer() < 3) != 0));
+                                                     life = 160 <= rng.integer() <= 300, fire_trail = true, collision = int(0 <= rng.integer() < 3) != 0, sprite_flip_x = rng.boolean()));
                 }
             }
         }
     };
 
-    World::World(std::string level_name) : state(std::make_unique<State>())
+    World::World(std::string level_name, seed_t seed) : state(std::make_unique<State>())
     {
         State &s = *state;
+        s.level_name = level_name;
+        s.seed = seed;
+        s.rng.set_seed(seed);
         s.map = Game::Map("assets/maps/{}.json"_format(level_name));
         s.p.pos = s.p.prev_pos = s.map.Points().GetSinglePoint("player") with(y -= 4);
         s.p.on_ground = s.p.prev_on_ground = s.p.SolidAtOffset(s.map, ivec2(0,1));
-        clamp_var(s.camera_pos = s.camera_pos_float = s.p.pos with(y -= s.p.camera_offset_y), screen_size/2, s.map.Tiles().size() * s.map.tile_size - screen_size/2);
+        clamp_var(s.camera_pos = s.camera_pos_float = s.p.pos with(y -= s.p.camera_offset_y), screen_size/2, s.map.Size() * s.map.tile_size - screen_size/2);
     }
     World::World(const World &other) : state(std::make_unique<State>(*other.state)) {}
     World::World(World &&other) = default;
@@ -292,6 +315,53 @@ namespace Components
         s.camera_shake     = other_s.camera_shake    ;
     }
 
+    const std::string &World::GetLevelName() const
+    {
+        return state->level_name;
+    }
+
+    World::seed_t World::GetSeed() const
+    {
+        return state->seed;
+    }
+
+    void World::ResetCircuitInputs()
+    {
+        state->circuit_io.ResetInputsAtNextAssignment();
+    }
+
+    std::uint64_t World::StateHash() const
+    {
+        const State &s = *state;
+
+        // This is saved to replays, so it must be the same on all platforms.
+        std::uint64_t ret = Hash::bytes_seed;
+
+        auto AppendVec = [&](auto vec)
+        {
+            Hash::AppendBytes(ret, vec.x, vec.y);
+        };
+
+        // Player
+        AppendVec(s.p.pos);
+        AppendVec(s.p.vel);
+        AppendVec(s.p.vel_lag);
+        Hash::AppendBytes(ret, std::uint8_t(s.p.on_ground), std::int32_t(s.p.jump_ticks_left), std::int32_t(s.p.death_timer), std::uint8_t(s.p.facing_left), std::int32_t(s.p.anim_frame));
+
+        // Circuit IO
+        Hash::AppendBytes(ret, std::uint8_t(s.circuit_io.out_at_least_one_tick_executed), std::uint8_t(s.circuit_io.in_control_left.Get()),
+            std::uint8_t(s.circuit_io.in_control_right.Get()), std::uint8_t(s.circuit_io.in_control_jump.Get()));
+        for (bool solid : s.circuit_io.out_solid_dir)
+            Hash::AppendBytes(ret, std::uint8_t(solid));
+
+        // Particles, mostly to make sure that the random number generator stays in sync.
+        Hash::AppendBytes(ret, std::uint64_t(s.particles.size()), std::uint64_t(s.scrap_particles.size()));
+        for (const State::ScrapParticle &par : s.scrap_particles)
+            AppendVec(par.pos);
+
+        return ret;
+    }
+
     MAYBE_CONST(
         CV World::State &World::GetState() CV
         {
@@ -299,15 +369,27 @@ namespace Components
         }
     )
 
-    void World::Tick()
+    World::Controls World::Controls::FromKeyboard()
+    {
+        Controls ret;
+        if (State::allow_debug_controls)
+        {
+            ret.left = Input::Button(Input::left).down();
+            ret.right = Input::Button(Input::right).down();
+            ret.jump = Input::Button(Input::up).down();
+        }
+        return ret;
+    }
+
+    void World::Tick(const Controls &controls)
     {
         State &s = *state;
 
         { // Walk controls
             if (s.allow_debug_controls)
             {
-                s.circuit_io.in_control_left.Assign(Input::Button(Input::left).down());
-                s.circuit_io.in_control_right.Assign(Input::Button(Input::right).down());
+                s.circuit_io.in_control_left.Assign(controls.left);
+                s.circuit_io.in_control_right.Assign(controls.right);
             }
 
             int hc = s.p.IsDead() ? 0 : s.circuit_io.in_control_right.Get() - s.circuit_io.in_control_left.Get();
@@ -350,7 +432,7 @@ namespace Components
         { // Jump controls and gravity
             if (s.allow_debug_controls)
             {
-                s.circuit_io.in_control_jump.Assign(Input::Button(Input::up).down());
+                s.circuit_io.in_control_jump.Assign(controls.jump);
             }
 
             if (s.p.on_ground)
@@ -428,7 +510,7 @@ namespace Components
                     s.p.Kill();
 
                 // Map bounds
-                if ((s.p.pos < 0).any() || (s.p.pos >= s.map.Tiles().size() * s.map.tile_size).any())
+                if ((s.p.pos < 0).any() || (s.p.pos >= s.map.Size() * s.map.tile_size).any())
                     s.p.Kill();
             }
         }
@@ -512,7 +594,7 @@ namespace Components
                     if (par.fire_trail)
                     {
                         float p = pow(1 - par.cur_age / float(par.life), 4);
-                        if (float(0 <= rng.real() <= 1) < p)
+                        if (float(0 <= s.rng.real() <= 1) < p)
                             s.ParticleEffect_FireTrail(1, par.pos, fvec2(1.5), par.vel with(y -= 1), fvec2(0.2));
                     }
                 }
@@ -531,14 +613,7 @@ namespace Components
             }
 
             { // Input
-                Meta::cexpr_for<Refl::Class::member_count<State::CircuitIO>>([&](auto index)
-                {
-                    constexpr auto i = index.value;
-                    if constexpr (std::is_same_v<State::CircuitIO::Input, Refl::Class::member_type<State::CircuitIO, i>>)
-                    {
-                        Refl::Class::Member<i>(s.circuit_io).ResetAtNextAssignment();
-                    }
-                });
+                s.circuit_io.ResetInputsAtNextAssignment();
             }
         }
 
@@ -568,7 +643,7 @@ namespace Components
 
             { // Clamp camera pos
                 fvec2 min_pos = screen_size/2;
-                fvec2 max_pos = s.map.Tiles().size() * s.map.tile_size - screen_size/2;
+                fvec2 max_pos = s.map.Size() * s.map.tile_size - screen_size/2;
 
                 for (int m = 0; m < 2; m++)
                 {
@@ -593,7 +668,7 @@ namespace Components
                     if (s.camera_shake[m] == 0)
                         continue;
 
-                    shake[m] = (1 <= rng.integer() <= s.camera_shake[m]) * rng.sign();
+                    shake[m] = (1 <= ::rng.integer() <= s.camera_shake[m]) * ::rng.sign(); // Sic, the global generator. This isn't a part of the simulation.
                 }
                 s.camera_shake -= sign(s.camera_shake);
             }
@@ -836,7 +911,7 @@ namespace Components
                 }
             }
 
-            void Render(ivec2 offset) const override
+            void Render(ivec2 offset, bool unpowered) const override
             {
                 int shape = 0;
                 switch (Mode)
@@ -853,7 +928,7 @@ namespace Components
                 {
                     for (size_t i = 0; i < size.prod(); i++)
                     {
-                        if (out_list[i].is_powered != powered)
+                        if ((out_list[i].is_powered && !unpowered) != powered)
                             continue;
 
                         ivec2 point_offset = PointIndexToOffset(i);
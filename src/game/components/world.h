@@ -1,9 +1,12 @@
 #pragma once
 
+#include <cstddef>
+#include <cstdint>
 #include <memory>
 #include <string>
 
 #include "macros/maybe_const.h"
+#include "utils/random.h"
 
 namespace Components
 {
@@ -16,7 +19,32 @@ namespace Components
         std::unique_ptr<State> state;
 
       public:
-        World(std::string level_name);
+        using seed_t = Random<>::seed_t;
+
+        // Player controls that come from the keyboard rather than from the circuit.
+        // Those are the only external inputs of a world tick, which makes them enough to replay a session.
+        struct Controls
+        {
+            bool left = false, right = false, jump = false;
+
+            [[nodiscard]] static Controls FromKeyboard(); // Returns no controls in release builds.
+
+            [[nodiscard]] std::uint8_t ToBits() const
+            {
+                return left | right << 1 | jump << 2;
+            }
+            [[nodiscard]] static Controls FromBits(std::uint8_t bits)
+            {
+                Controls ret;
+                ret.left = bits & 1;
+                ret.right = bits & 2;
+                ret.jump = bits & 4;
+                return ret;
+            }
+        };
+
+        // The world has its own random number generator, seeded with `seed`, so that the simulation is deterministic.
+        World(std::string level_name, seed_t seed = 0);
         World(const World &);
         World(World &&);
         World &operator=(const World &);
@@ -25,9 +53,18 @@ namespace Components
 
         void CopyPersistentStateFrom(const World &other);
 
+        [[nodiscard]] const std::string &GetLevelName() const;
+        [[nodiscard]] seed_t GetSeed() const;
+
+        // Forgets the values written by the circuit outside of `Tick()`, e.g. by circuit ticks in the editor mode.
+        void ResetCircuitInputs();
+
+        // Hashes the simulation state (but not the persistent state, such as the camera position).
+        [[nodiscard]] std::uint64_t StateHash() const;
+
         MAYBE_CONST( CV State &GetState() CV; )
 
-        void Tick();
+        void Tick(const Controls &controls);
         void PersistentTick();
 
         void Render() const;
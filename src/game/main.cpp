@@ -1,5 +1,8 @@
 #include "game/main.h"
 
+#include "game/components/circuit_file.h"
+#include "game/components/replay.h"
+
 Interface::Window window("Circuit Bros", screen_size * 2, Interface::windowed, adjust_(Interface::WindowSettings{}, min_size = screen_size));
 static Graphics::DummyVertexArray dummy_vao = nullptr;
 
@@ -14,18 +17,30 @@ Graphics::Font &font_main()
 
 Graphics::TextureAtlas &texture_atlas()
 {
-    static Graphics::FontFile font_file_main("assets/Cat12.ttf", 12);
     static Graphics::TextureAtlas ret(ivec2(2048), "assets/_images", "assets/atlas.png", "assets/atlas.refl");
-    Graphics::Image &image = ret.GetImage();
-    auto region = ret.Get("font_storage.png");
-    Unicode::CharSet ranges({Unicode::Ranges::Basic_Latin, Unicode::Ranges::Cyrillic});
-    std::vector<Graphics::FontAtlasEntry> entries = {
-        Graphics::FontAtlasEntry(font_main(), font_file_main, ranges, Graphics::FontFile::monochrome | Graphics::FontFile::hinting_mode_light, Graphics::FontAtlasEntry::no_line_gap),
-    };
-    Graphics::MakeFontAtlas(image, region.pos, region.size, entries);
     return ret;
 }
-Graphics::Texture texture_main = Graphics::Texture(nullptr).Wrap(Graphics::clamp).Interpolation(Graphics::nearest).SetData(texture_atlas().GetImage());
+
+static const std::string font_prewarm_file = "assets/font_prewarm.txt";
+
+// Rasterizes the glyphs of `font_main()` on demand, into the `font_storage.png` region of the atlas.
+// The glyphs used last time are loaded from `assets/font_cache.bin` if it's up to date, without initializing FreeType.
+static Graphics::GlyphCache &glyph_cache_main()
+{
+    static const Graphics::TextureAtlas::Region region = texture_atlas().Get("font_storage.png");
+    static Graphics::GlyphCache ret(font_main(), "assets/Cat12.ttf", 12, Graphics::FontFile::monochrome | Graphics::FontFile::hinting_mode_light,
+                                    texture_atlas().GetImage(), region.pos, region.size, Graphics::GlyphCache::no_line_gap,
+                                    Graphics::GlyphCache::ReadPrewarmList(font_prewarm_file), "assets/font_cache.bin");
+    return ret;
+}
+
+Graphics::Texture texture_main = []{
+    // Pre-warm the glyphs before uploading the atlas. The new glyphs are uploaded as they get rasterized.
+    glyph_cache_main();
+    Graphics::Texture ret = Graphics::Texture(nullptr).Wrap(Graphics::clamp).Interpolation(Graphics::nearest).SetData(texture_atlas().GetImage());
+    glyph_cache_main().SetUploadFunc([](ivec2 pos, const Graphics::Image &cell){texture_main.SetDataPart(pos, cell.Size(), cell.Data());});
+    return ret;
+}();
 
 AdaptiveViewport adaptive_viewport(shader_config, screen_size);
 Render r = adjust_(Render(0x2000, shader_config), SetTexture(texture_main), SetMatrix(adaptive_viewport.GetDetails().MatrixCentered()));
@@ -90,7 +105,10 @@ struct ProgramState : Program::DefaultBasicState
             Graphics::Viewport(window.Size());
         }
         if (window.ExitRequested())
+        {
+            glyph_cache_main().SavePrewarmList(font_prewarm_file);
             Program::Exit();
+        }
 
         gui_controller.PreTick();
         ImGui::GetIO().MouseDrawCursor = ImGui::IsAnyWindowHovered();
@@ -102,6 +120,7 @@ struct ProgramState : Program::DefaultBasicState
     {
         frame_counter++;
 
+        glyph_cache_main().NewFrame();
         gui_controller.PreRender();
         adaptive_viewport.BeginFrame();
         HighLevelRender();
@@ -142,8 +161,37 @@ struct ProgramState : Program::DefaultBasicState
     }
 };
 
-int _main_(int, char **)
+int _main_(int argc, char **argv)
 {
+    // `--verify-replay <file>` re-runs a recorded replay without rendering, and reports whether the simulation is deterministic.
+    if (argc == 3 && argv[1] == std::string_view("--verify-replay"))
+    {
+        auto result = Components::Replay::Verify(Components::Replay::Load(argv[2]));
+        if (!result.Ok())
+        {
+            std::cout << "Replay desync at tick " << result.first_mismatched_tick << ".\n";
+            return 1;
+        }
+        std::cout << "Replay OK, " << result.ticks << " ticks, " << result.hashes_checked << " hashes checked.\n";
+        return 0;
+    }
+
+    // `--benchmark-circuit-io <file>` measures the save/load speed of the circuit, in both binary and text formats.
+    if (argc == 3 && argv[1] == std::string_view("--benchmark-circuit-io"))
+    {
+        auto result = Components::CircuitFile::Benchmark(Components::CircuitFile::Load(argv[2]), 20);
+        std::cout << "Binary: " << result.binary_size << " bytes, save " << result.binary_save_mb_per_sec << " MB/s, load " << result.binary_load_mb_per_sec << " MB/s.\n";
+        std::cout << "Text:   " << result.text_size << " bytes, save " << result.text_save_mb_per_sec << " MB/s, load " << result.text_load_mb_per_sec << " MB/s.\n";
+        return 0;
+    }
+
+    // `--atlas-report` prints how densely the texture atlas is packed.
+    if (argc == 2 && argv[1] == std::string_view("--atlas-report"))
+    {
+        std::cout << texture_atlas().OccupancyReport();
+        return 0;
+    }
+
     state_manager.SetState(State::Tag("Game"));
 
     ProgramState loop_state;
@@ -1,8 +1,15 @@
+#include <filesystem>
 #include <optional>
 
+#include <imgui_stdlib.h>
+
+#include "game/components/breakpoints.h"
 #include "game/components/circuit.h"
+#include "game/components/circuit_file.h"
 #include "game/components/editor.h"
 #include "game/components/menu_controller.h"
+#include "game/components/probes.h"
+#include "game/components/replay.h"
 #include "game/components/tooltip_controller.h"
 #include "game/components/world.h"
 #include "game/main.h"
@@ -21,6 +28,13 @@ namespace States
         Components::TooltipController tooltip_controller;
         Components::MenuController menu_controller;
 
+        std::string new_breakpoint_expression, breakpoint_error;
+
+        IF_CIRCUIT_PROFILING(
+            Components::CircuitProfiler circuit_profiler;
+            bool circuit_profiler_enabled = false;
+        )
+
         Game()
         {
             world = world_copy = Components::World("1");
@@ -50,8 +64,7 @@ namespace States
                     {
                         try
                         {
-                            Stream::Output out("saved_circuit_{}.refl"_format(i));
-                            Refl::ToString(circuit, out, Refl::ToStringOptions::Pretty());
+                            Components::CircuitFile::Save(circuit, "saved_circuit_{}.circuit"_format(i));
                         }
                         catch (std::exception &e)
                         {
@@ -61,13 +74,31 @@ namespace States
 
                     ImGui::SameLine();
 
+                    if (ImGui::Button("Export text #{}"_format(i).c_str()))
+                    {
+                        try
+                        {
+                            Components::CircuitFile::Save(circuit, "saved_circuit_{}.refl"_format(i), Components::CircuitFile::Format::text);
+                        }
+                        catch (std::exception &e)
+                        {
+                            Interface::MessageBox("Error", "Unable to export:\n{}"_format(e.what()));
+                        }
+                    }
+
+                    ImGui::SameLine();
+
                     if (ImGui::Button("Load #{}"_format(i).c_str()))
                     {
                         try
                         {
-                            Stream::Input in("saved_circuit_{}.refl"_format(i));
+                            // Fall back to the text format for the old saves.
+                            std::string file_name = "saved_circuit_{}.circuit"_format(i);
+                            if (!std::filesystem::exists(file_name))
+                                file_name = "saved_circuit_{}.refl"_format(i);
+                            Components::Circuit new_circuit = Components::CircuitFile::Load(file_name);
                             LoadMap("1");
-                            Refl::FromString(circuit, in);
+                            circuit = std::move(new_circuit);
                         }
                         catch (std::exception &e)
                         {
@@ -75,7 +106,151 @@ namespace States
                         }
                     }
                 }
+
+                ImGui::Separator();
+
+                const Components::Replay &replay = editor.GetReplay();
+                ImGui::Text("Replay: {} ticks{}"_format(replay.TickCount(), replay.IsRecording() ? ", recording" : "").c_str());
+
+                if (ImGui::Button("Save replay") && !replay.IsEmpty())
+                {
+                    try
+                    {
+                        replay.Save("replay.bin");
+                    }
+                    catch (std::exception &e)
+                    {
+                        Interface::MessageBox("Error", "Unable to save replay:\n{}"_format(e.what()));
+                    }
+                }
+
+                ImGui::SameLine();
+
+                if (ImGui::Button("Verify replay"))
+                {
+                    try
+                    {
+                        auto result = Components::Replay::Verify(Components::Replay::Load("replay.bin"));
+                        if (result.Ok())
+                            Interface::MessageBox("Replay", "OK, {} ticks, {} hashes checked."_format(result.ticks, result.hashes_checked));
+                        else
+                            Interface::MessageBox("Replay", "Desync at tick {}."_format(result.first_mismatched_tick));
+                    }
+                    catch (std::exception &e)
+                    {
+                        Interface::MessageBox("Error", "Unable to verify replay:\n{}"_format(e.what()));
+                    }
+                }
+
+                ImGui::Separator();
+
+                const Components::Probes &probes = editor.GetProbes();
+                ImGui::Text("Probes: %d (press P over an 'out' point)", int(probes.GetProbes().size()));
+                if (probes.IsRecording())
+                    ImGui::Text("Recording to `probes.vcd`, %d lost changes", int(probes.LostChangeCount()));
+            }
+
+            { // Breakpoints window
+                ImGui::SetNextWindowPos(ivec2(0, 400), ImGuiCond_Appearing);
+
+                ImGui::Begin("Breakpoints", nullptr, ImGuiWindowFlags_AlwaysAutoResize);
+                FINALLY( ImGui::End(); )
+
+                Components::Breakpoints &breakpoints = editor.GetBreakpoints();
+
+                ImGui::TextUnformatted("Terms: `id[.point]`, `!id` (off), `^id` (rises), `vid` (falls), `~id` (changes), joined with `&`.");
+
+                std::size_t index_to_remove = -1;
+                for (std::size_t i = 0; i < breakpoints.GetBreakpoints().size(); i++)
+                {
+                    const Components::Breakpoints::Breakpoint &breakpoint = breakpoints.GetBreakpoints()[i];
+                    ImGui::PushID(int(i));
+                    FINALLY( ImGui::PopID(); )
+
+                    bool enabled = breakpoint.enabled;
+                    if (ImGui::Checkbox("##enabled", &enabled))
+                        breakpoints.SetEnabled(i, enabled);
+                    ImGui::SameLine();
+                    if (i == editor.LastFiredBreakpoint())
+                        ImGui::TextColored(ImVec4(1, 0.5, 0, 1), "%s (hits: %d)", breakpoint.expression.c_str(), int(breakpoint.hit_count));
+                    else
+                        ImGui::Text("%s (hits: %d)", breakpoint.expression.c_str(), int(breakpoint.hit_count));
+                    ImGui::SameLine();
+                    if (ImGui::SmallButton("Remove"))
+                        index_to_remove = i;
+                }
+                if (index_to_remove != std::size_t(-1))
+                    breakpoints.Remove(index_to_remove);
+
+                if (ImGui::InputText("Add", &new_breakpoint_expression, ImGuiInputTextFlags_EnterReturnsTrue))
+                {
+                    try
+                    {
+                        breakpoints.Add(new_breakpoint_expression);
+                        new_breakpoint_expression.clear();
+                        breakpoint_error.clear();
+                    }
+                    catch (std::exception &e)
+                    {
+                        breakpoint_error = e.what();
+                    }
+                }
+                if (!breakpoint_error.empty())
+                    ImGui::TextColored(ImVec4(1, 0.2, 0.2, 1), "%s", breakpoint_error.c_str());
+            }
+
+            IF_CIRCUIT_PROFILING(
+            { // Debug "circuit profiler" window
+                ImGui::SetNextWindowPos(ivec2(0, 200), ImGuiCond_Appearing);
+
+                ImGui::Begin("Circuit profiler", nullptr, ImGuiWindowFlags_AlwaysAutoResize);
+                FINALLY( ImGui::End(); )
+
+                if (ImGui::Checkbox("Enabled", &circuit_profiler_enabled))
+                    circuit_profiler.Reset();
+                // The pointer is refreshed every tick, since the state can be moved around.
+                circuit.SetProfiler(circuit_profiler_enabled ? &circuit_profiler : nullptr);
+
+                if (circuit_profiler_enabled)
+                {
+                    const Components::CircuitProfiler::Report &report = circuit_profiler.GetReport();
+                    ImGui::Text("Averages per tick, over %d ticks.", Components::CircuitProfiler::window_ticks);
+
+                    auto CountersTable = [](const char *id, const char *title, const auto &entries, const Components::CircuitProfiler::Counters *total)
+                    {
+                        ImGui::Columns(4, id);
+                        FINALLY( ImGui::Columns(1); )
+
+                        ImGui::Separator();
+                        for (const char *header : {title, "Evals", "Reads", "Time, us"})
+                        {
+                            ImGui::TextUnformatted(header);
+                            ImGui::NextColumn();
+                        }
+                        ImGui::Separator();
+
+                        auto Row = [](const char *name, const Components::CircuitProfiler::Counters &counters)
+                        {
+                            ImGui::TextUnformatted(name); ImGui::NextColumn();
+                            ImGui::Text("%.1f", counters.evaluations); ImGui::NextColumn();
+                            ImGui::Text("%.1f", counters.connection_reads); ImGui::NextColumn();
+                            ImGui::Text("%.2f", counters.seconds * 1e6); ImGui::NextColumn();
+                        };
+                        for (const auto &entry : entries)
+                            Row(entry.name.c_str(), entry.counters);
+                        if (total)
+                        {
+                            ImGui::Separator();
+                            Row("Total", *total);
+                        }
+                        ImGui::Separator();
+                    };
+
+                    CountersTable("node_types", "Node type", report.node_types, &report.total);
+                    CountersTable("hottest_nodes", "Hottest nodes", report.hottest_nodes, nullptr);
+                }
             }
+            )
 
             editor.Tick(world, world_copy, circuit, menu_controller, tooltip_controller);
             if (Input::Button(Input::tab).pressed())
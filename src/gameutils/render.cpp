@@ -276,14 +276,24 @@ Render::Text_t::~Text_t()
 
         for (const Graphics::Text::Symbol &symbol : line.symbols)
         {
+            ivec2 texture_pos = symbol.texture_pos, symbol_offset = symbol.offset, symbol_size = symbol.size;
+            if (symbol.font)
+            {
+                // This also marks the glyph as used, so a `GlyphCache` doesn't evict it.
+                const Graphics::Font::Glyph &glyph = symbol.font->Get(symbol.ch);
+                texture_pos = glyph.texture_pos;
+                symbol_offset = glyph.offset;
+                symbol_size = glyph.size;
+            }
+
             fvec2 symbol_pos;
 
             if (!data.has_matrix)
-                symbol_pos = pos + offset + symbol.offset;
+                symbol_pos = pos + offset + symbol_offset;
             else
-                symbol_pos = pos + (data.matrix * (offset + symbol.offset).to_vec3(1)).to_vec2();
+                symbol_pos = pos + (data.matrix * (offset + symbol_offset).to_vec3(1)).to_vec2();
 
-            auto quad = renderer->fquad(symbol_pos, symbol.size).tex(symbol.texture_pos).color(data.color).mix(0).alpha(data.alpha).beta(data.beta);
+            auto quad = renderer->fquad(symbol_pos, symbol_size).tex(texture_pos).color(data.color).mix(0).alpha(data.alpha).beta(data.beta);
             if (data.has_matrix)
                 quad.matrix(data.matrix.to_mat2()).pixel_center(fvec2(0));
 
@@ -1,6 +1,20 @@
 #include "tiled_map.h"
 
+#include <cstdint>
+#include <cstring>
+#include <ctime>
+#include <optional>
+#include <utility>
+#include <vector>
+
 #include "program/errors.h"
+#include "reflection/full.h"
+#include "stream/input.h"
+#include "stream/output.h"
+#include "stream/readonly_data.h"
+#include "utils/archive.h"
+#include "utils/byte_order.h"
+#include "utils/filesystem.h"
 #include "utils/mat.h"
 
 namespace Tiled
@@ -79,4 +93,267 @@ namespace Tiled
         });
         return ret;
     }
+
+    const TileLayer *Map::FindTileLayer(std::string_view name) const
+    {
+        if (auto it = tile_layers.find(name); it != tile_layers.end())
+            return &it->second;
+        if (point_layers.find(name) != point_layers.end())
+            Program::Error("Expected `", name, "` to be a tile layer.");
+        return nullptr;
+    }
+
+    const PointLayer *Map::FindPointLayer(std::string_view name) const
+    {
+        if (auto it = point_layers.find(name); it != point_layers.end())
+            return &it->second;
+        if (tile_layers.find(name) != tile_layers.end())
+            Program::Error("Expected `", name, "` to be an object layer.");
+        return nullptr;
+    }
+
+    static void LoadLayer(Json::Reader &reader, Map &map)
+    {
+        // The keys can be in any order, and Tiled writes `data` and `objects` before the layer type and size,
+        // so we remember where they are, and read them after the rest of the layer.
+        std::string name, type;
+        ivec2 size(-1);
+        std::optional<Json::Reader::Bookmark> data, objects;
+
+        reader.ReadObject([&](std::string_view key)
+        {
+            if (key == "name")
+                name = reader.ReadString();
+            else if (key == "type")
+                type = reader.ReadString();
+            else if (key == "width")
+                size.x = reader.ReadInt();
+            else if (key == "height")
+                size.y = reader.ReadInt();
+            else if (key == "data")
+                data = reader.SkipToBookmark();
+            else if (key == "objects")
+                objects = reader.SkipToBookmark();
+            else
+                reader.Skip();
+        });
+
+        if (type != "tilelayer" && type != "objectgroup")
+            return;
+
+        if (map.tile_layers.find(name) != map.tile_layers.end() || map.point_layers.find(name) != map.point_layers.end())
+            Program::Error("More than one layer is named `", name, "`.");
+
+        if (type == "tilelayer")
+        {
+            if (size.x < 0 || size.y < 0 || !data)
+                Program::Error("Expected tile layer `", name, "` to have `width`, `height`, and `data`.");
+
+            // The tiles are stored in the same order as in `MultiArray`, so we decode them in place.
+            TileLayer layer(size);
+            reader.Revisit(*data, [&]
+            {
+                reader.ReadIntArray(layer.elements(), size.prod());
+            });
+            map.tile_layers.emplace(std::move(name), std::move(layer));
+        }
+        else
+        {
+            PointLayer layer;
+            if (objects)
+            {
+                reader.Revisit(*objects, [&]
+                {
+                    reader.ReadArray([&](int)
+                    {
+                        std::string point_name;
+                        fvec2 pos;
+                        bool is_point = false;
+
+                        reader.ReadObject([&](std::string_view key)
+                        {
+                            if (key == "name")
+                                point_name = reader.ReadString();
+                            else if (key == "x")
+                                pos.x = reader.ReadReal();
+                            else if (key == "y")
+                                pos.y = reader.ReadReal();
+                            else if (key == "point")
+                                is_point = reader.ReadBool();
+                            else
+                                reader.Skip();
+                        });
+
+                        if (!is_point)
+                            Program::Error("Expected every object on layer `", name, "` to be a point.");
+
+                        layer.points.insert({std::move(point_name), pos});
+                    });
+                });
+            }
+            map.point_layers.emplace(std::move(name), std::move(layer));
+        }
+    }
+
+    Map LoadMap(const char *json)
+    {
+        Map ret;
+        Json::Reader reader(json, 32);
+
+        reader.ReadObject([&](std::string_view key)
+        {
+            if (key == "layers")
+            {
+                reader.ReadArray([&](int)
+                {
+                    LoadLayer(reader, ret);
+                });
+            }
+            else if (key == "properties")
+            {
+                reader.ReadArray([&](int)
+                {
+                    std::string name, type;
+                    std::optional<std::string> value;
+
+                    reader.ReadObject([&](std::string_view key)
+                    {
+                        if (key == "name")
+                            name = reader.ReadString();
+                        else if (key == "type")
+                            type = reader.ReadString();
+                        else if (key == "value" && reader.PeekType() == Json::string)
+                            value = reader.ReadString();
+                        else
+                            reader.Skip();
+                    });
+
+                    if (type == "string" && value)
+                        ret.properties.strings.insert({std::move(name), std::move(*value)});
+                });
+            }
+            else
+            {
+                reader.Skip();
+            }
+        });
+
+        reader.ExpectEnd();
+        return ret;
+    }
+
+    namespace
+    {
+        // The contents of a map cache file. Stored after `cache_magic` and `cache_version`.
+        REFL_SIMPLE_STRUCT( CachedTileLayer
+            REFL_DECL(ivec2) size
+            REFL_DECL(std::vector<std::uint8_t>) tiles // Compressed 32-bit little-endian integers, see `utils/archive.h`.
+        )
+
+        REFL_SIMPLE_STRUCT( CachedMap
+            REFL_DECL(std::map<std::string, CachedTileLayer>) tile_layers
+            REFL_DECL(std::map<std::string, std::multimap<std::string, fvec2>>) point_layers
+            REFL_DECL(std::map<std::string, std::string>) strings
+        )
+
+        constexpr char cache_magic[] = "TILEDMAP"; // The null-terminator is not written.
+        constexpr std::uint32_t cache_version = 1;
+
+        [[nodiscard]] Map LoadCache(const std::string &cache_file_name)
+        {
+            Stream::Input input(cache_file_name);
+            if (!input.DiscardChars<Stream::if_present>(cache_magic, std::strlen(cache_magic)))
+                Program::Error("Not a map cache.");
+            if (input.ReadLittle<std::uint32_t>() != cache_version)
+                Program::Error("Wrong map cache version.");
+
+            CachedMap cached;
+            Refl::FromBinary(cached, input);
+
+            Map ret;
+            for (auto &[name, cached_layer] : cached.tile_layers)
+            {
+                const std::uint8_t *tiles_begin = cached_layer.tiles.data(), *tiles_end = tiles_begin + cached_layer.tiles.size();
+                if (cached_layer.size.min() < 0 || Archive::UncompressedSize(tiles_begin, tiles_end) != cached_layer.size.prod() * sizeof(std::int32_t))
+                    Program::Error("Invalid tile layer size in the map cache.");
+
+                std::vector<std::uint8_t> bytes(cached_layer.size.prod() * sizeof(std::int32_t));
+                Archive::Uncompress(tiles_begin, tiles_end, bytes.data());
+
+                TileLayer layer(cached_layer.size);
+                for (int i = 0, count = cached_layer.size.prod(); i < count; i++)
+                {
+                    std::int32_t value;
+                    std::memcpy(&value, bytes.data() + i * sizeof value, sizeof value);
+                    ByteOrder::Convert(value, ByteOrder::little);
+                    layer.elements()[i] = value;
+                }
+                ret.tile_layers.emplace(name, std::move(layer));
+            }
+            for (auto &[name, points] : cached.point_layers)
+                ret.point_layers.emplace(name, PointLayer{std::move(points)});
+            ret.properties.strings = std::move(cached.strings);
+            return ret;
+        }
+
+        void SaveCache(const Map &map, const std::string &cache_file_name)
+        {
+            CachedMap cached;
+            for (const auto &[name, layer] : map.tile_layers)
+            {
+                std::vector<std::uint8_t> bytes(layer.size().prod() * sizeof(std::int32_t));
+                for (int i = 0, count = layer.size().prod(); i < count; i++)
+                {
+                    std::int32_t value = layer.elements()[i];
+                    ByteOrder::Convert(value, ByteOrder::little);
+                    std::memcpy(bytes.data() + i * sizeof value, &value, sizeof value);
+                }
+
+                CachedTileLayer &cached_layer = cached.tile_layers[name];
+                cached_layer.size = layer.size();
+                cached_layer.tiles.resize(Archive::MaxCompressedSize(bytes.data(), bytes.data() + bytes.size()));
+                std::uint8_t *tiles_end = Archive::Compress(bytes.data(), bytes.data() + bytes.size(), cached_layer.tiles.data(), cached_layer.tiles.data() + cached_layer.tiles.size());
+                cached_layer.tiles.resize(tiles_end - cached_layer.tiles.data());
+            }
+            for (const auto &[name, layer] : map.point_layers)
+                cached.point_layers.emplace(name, layer.points);
+            cached.strings = map.properties.strings;
+
+            Stream::Output output(cache_file_name);
+            output.WriteString(cache_magic);
+            output.WriteLittle<std::uint32_t>(cache_version);
+            Refl::ToBinary(cached, output);
+            output.Flush();
+        }
+    }
+
+    Map LoadMapCached(const std::string &file_name, const std::string &cache_file_name)
+    {
+        // Same as in `Graphics::TextureAtlas`, the cache is used only if it's strictly newer than the source.
+        std::time_t source_time_modified = Filesystem::GetObjectInfo(file_name).time_modified;
+
+        bool cache_ok = false;
+        auto cache_info = Filesystem::GetObjectInfo(cache_file_name, &cache_ok);
+        if (cache_ok && cache_info.category == Filesystem::file && source_time_modified < cache_info.time_modified)
+        {
+            try
+            {
+                return LoadCache(cache_file_name);
+            }
+            catch (...)
+            {
+                // Regenerate the cache.
+            }
+        }
+
+        Map ret = LoadMap(Stream::ReadOnlyData(file_name).string());
+
+        try
+        {
+            SaveCache(ret, cache_file_name);
+        }
+        catch (...) {}
+
+        return ret;
+    }
 }
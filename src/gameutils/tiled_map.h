@@ -5,6 +5,7 @@
 #include <map>
 #include <optional>
 #include <string>
+#include <string_view>
 
 #include "program/errors.h"
 #include "strings/common.h"
@@ -91,4 +92,24 @@ namespace Tiled
     };
 
     Properties LoadProperties(Json::View map);
+
+    // A map loaded in a single pass with `Json::Reader`, without building a `Json` tree. Prefer this for large maps.
+    // Only the tile layers, the object layers (which must contain only points), and the string properties are loaded.
+    struct Map
+    {
+        std::map<std::string, TileLayer, std::less<>> tile_layers;
+        std::map<std::string, PointLayer, std::less<>> point_layers;
+        Properties properties;
+
+        // Return null if there is no such layer. Throw if the layer has a different type.
+        [[nodiscard]] const TileLayer *FindTileLayer(std::string_view name) const;
+        [[nodiscard]] const PointLayer *FindPointLayer(std::string_view name) const;
+    };
+
+    // `json` must be null-terminated.
+    [[nodiscard]] Map LoadMap(const char *json);
+
+    // Same as `LoadMap()`, but also saves the map to a binary `cache_file_name`, and loads it from there next time if it's newer than `file_name`.
+    // If the cache can't be loaded or saved, it's silently ignored.
+    [[nodiscard]] Map LoadMapCached(const std::string &file_name, const std::string &cache_file_name);
 }
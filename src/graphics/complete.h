@@ -8,6 +8,7 @@
 #include "graphics/font.h"
 #include "graphics/framebuffer.h"
 #include "graphics/geometry.h"
+#include "graphics/glyph_cache.h"
 #include "graphics/image.h"
 #include "graphics/index_buffer.h"
 #include "graphics/renderer_flat.h"
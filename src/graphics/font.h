@@ -1,5 +1,6 @@
 #pragma once
 
+#include <cstdint>
 #include <functional>
 #include <unordered_map>
 #include <utility>
@@ -17,6 +18,8 @@ namespace Graphics
             ivec2 size = ivec2(0);
             ivec2 offset = ivec2(0);
             int advance = 0;
+
+            mutable std::uint64_t last_use = 0; // Updated by `Font::Get()`, see `UseCounter()`. This lets `GlyphCache` find the least recently used glyphs.
         };
 
       private:
@@ -27,6 +30,11 @@ namespace Graphics
         using kerning_func_t = std::function<int(uint32_t, uint32_t)>;
         kerning_func_t kerning_func = 0;
 
+        using missing_glyph_func_t = std::function<bool(uint32_t)>;
+        missing_glyph_func_t missing_glyph_func = 0;
+
+        mutable std::uint64_t use_counter = 0;
+
         // Some code might rely on references not being invalidated on insertion. Keep that in mind if you decide to change the container.
         std::unordered_map<uint32_t, Glyph> glyphs;
         Glyph default_glyph;
@@ -49,6 +57,13 @@ namespace Graphics
             kerning_func = std::move(new_kerning_func);
         }
 
+        // `Get()` calls this function when it doesn't find a glyph. The function can `Insert()` it and return true, then it's looked up again.
+        // This is how `GlyphCache` rasterizes the glyphs on demand.
+        void SetMissingGlyphFunc(missing_glyph_func_t new_missing_glyph_func)
+        {
+            missing_glyph_func = std::move(new_missing_glyph_func);
+        }
+
         int Ascent() const
         {
             return ascent;
@@ -95,17 +110,38 @@ namespace Graphics
             return default_glyph;
         }
 
-        // Note that returned references remain valid even after insertions.
+        // Note that returned references remain valid even after insertions, but not after `Erase()`.
         const Glyph &Get(uint32_t ch) const
         {
-            if (auto it = glyphs.find(ch); it != glyphs.end())
-                return it->second;
-            else
+            auto it = glyphs.find(ch);
+            if (it == glyphs.end() && missing_glyph_func && missing_glyph_func(ch))
+                it = glyphs.find(ch);
+
+            if (it == glyphs.end())
                 return default_glyph;
+
+            it->second.last_use = ++use_counter;
+            return it->second;
+        }
+        // Unlike `Get()`, doesn't call the missing glyph function and doesn't update `last_use`. Returns null if there is no such glyph.
+        const Glyph *Find(uint32_t ch) const
+        {
+            auto it = glyphs.find(ch);
+            return it != glyphs.end() ? &it->second : nullptr;
         }
         Glyph &Insert(uint32_t ch) // If the glyph already exists, returns a reference to it instead of creating a new one.
         {
             return glyphs.insert({ch, {}}).first->second;
         }
+        void Erase(uint32_t ch)
+        {
+            glyphs.erase(ch);
+        }
+
+        // Incremented by every `Get()` that finds a glyph, the new value is stored into its `last_use`.
+        std::uint64_t UseCounter() const
+        {
+            return use_counter;
+        }
     };
 }
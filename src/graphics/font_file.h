@@ -156,6 +156,16 @@ namespace Graphics
         {
             return LineSkip() - Height();
         }
+        // An upper bound on the size of any rendered glyph. Computed from the bounding box of the font, plus a pixel on each side for the rounding and the hinting.
+        ivec2 MaxGlyphSize() const
+        {
+            FT_Face face = data.ft_font;
+            if (!FT_IS_SCALABLE(face))
+                return ivec2(face->size->metrics.max_advance >> 6, Height()) + 2; // Bitmap fonts have no bounding box. See `Ascent()` for why we bit-shift.
+
+            ivec2 size(FT_MulFix(face->bbox.xMax - face->bbox.xMin, face->size->metrics.x_scale), FT_MulFix(face->bbox.yMax - face->bbox.yMin, face->size->metrics.y_scale));
+            return (size + 63) / 64 + 2; // The size is measured in 26.6 fixed point pixels, so we round it up.
+        }
         bool HasKerning() const
         {
             return FT_HAS_KERNING(data.ft_font);
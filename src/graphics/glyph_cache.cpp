@@ -0,0 +1,429 @@
+#include "glyph_cache.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include "program/errors.h"
+#include "reflection/full.h"
+#include "stream/input.h"
+#include "stream/output.h"
+#include "stream/save_to_file.h"
+#include "utils/archive.h"
+#include "utils/hash.h"
+#include "utils/unicode.h"
+
+namespace Graphics
+{
+    namespace
+    {
+        // The contents of a glyph cache file. Stored after `cache_magic` and `cache_version`.
+        REFL_SIMPLE_STRUCT( CachedGlyph
+            REFL_DECL(std::uint32_t) ch
+            REFL_DECL(ivec2) size, offset
+            REFL_DECL(int) advance
+        )
+
+        REFL_SIMPLE_STRUCT( CachedKerningPair
+            REFL_DECL(std::uint32_t) a, b
+            REFL_DECL(int) kerning
+        )
+
+        REFL_SIMPLE_STRUCT( CachedFont
+            // The cache is only used if all of those match.
+            REFL_DECL(std::uint64_t) font_file_hash // `Hash::Bytes()` of the font file.
+            REFL_DECL(int) font_size, render_flags, flags
+            REFL_DECL(std::string) prewarm_chars
+
+            REFL_DECL(int) ascent, descent, line_skip
+            REFL_DECL(ivec2) cell_size
+            REFL_DECL(bool) has_default_glyph
+            REFL_DECL(CachedGlyph) default_glyph
+            REFL_DECL(std::vector<CachedGlyph>) glyphs // Sorted by character.
+            REFL_DECL(std::vector<std::uint32_t>) missing_chars
+            REFL_DECL(bool) has_kerning
+            REFL_DECL(std::vector<CachedKerningPair>) kerning_pairs // Between all pre-warm characters, except the zeroes.
+            REFL_DECL(std::vector<std::uint8_t>) alpha // Compressed alpha of all glyph pixels, starting from the default glyph, see `utils/archive.h`. The color is always white.
+        )
+
+        constexpr char cache_magic[] = "CBGLYPHS"; // The null-terminator is not written.
+        constexpr std::uint32_t cache_version = 1;
+
+        [[nodiscard]] std::uint64_t KerningKey(uint32_t a, uint32_t b)
+        {
+            return std::uint64_t(a) << 32 | b;
+        }
+
+        // Returns the sorted unique characters of a UTF-8 string.
+        [[nodiscard]] std::vector<uint32_t> UniqueChars(const std::string &chars)
+        {
+            std::vector<uint32_t> ret;
+            for (uint32_t ch : Unicode::Iterator(chars))
+                ret.push_back(ch);
+            std::sort(ret.begin(), ret.end());
+            ret.erase(std::unique(ret.begin(), ret.end()), ret.end());
+            return ret;
+        }
+    }
+
+    const FontFile &GlyphCache::Source()
+    {
+        if (!source)
+            source.emplace(font_file, font_size);
+        return *source;
+    }
+
+    void GlyphCache::Init(int ascent, int descent, int line_skip, ivec2 new_cell_size, bool has_kerning)
+    {
+        target->SetAscent(ascent);
+        target->SetDescent(descent);
+        target->SetLineSkip(line_skip);
+
+        if (has_kerning)
+        {
+            target->SetKerningFunc([this](uint32_t a, uint32_t b)
+            {
+                if (cached_kerning_chars.count(a) && cached_kerning_chars.count(b))
+                {
+                    auto it = cached_kerning.find(KerningKey(a, b));
+                    return it != cached_kerning.end() ? it->second : 0;
+                }
+                return Source().Kerning(a, b);
+            });
+        }
+        else
+        {
+            target->SetKerningFunc(0);
+        }
+
+        cell_size = new_cell_size;
+        cell_count = (region_size + 1) / (cell_size + 1);
+        if ((cell_count < 1).any() || cell_count.prod() < 2)
+            Program::Error("A ", region_size.x, 'x', region_size.y, " region is too small for a glyph cache, each glyph needs ", cell_size.x, 'x', cell_size.y, " pixels.");
+
+        for (int i = cell_count.prod() - 1; i >= 0; i--)
+            free_cells.push_back(i);
+    }
+
+    void GlyphCache::InitFromSource()
+    {
+        const FontFile &font = Source();
+        Init(font.Ascent(), font.Descent(), flags & no_line_gap ? font.Height() : font.LineSkip(), font.MaxGlyphSize(), font.HasKerning());
+
+        if (font.HasGlyph(Unicode::default_char))
+            DrawGlyph(target->DefaultGlyph(), AllocateCell(), font.GetGlyph(Unicode::default_char, render_flags));
+    }
+
+    int GlyphCache::AllocateCell()
+    {
+        if (free_cells.size() > 0)
+        {
+            int ret = free_cells.back();
+            free_cells.pop_back();
+            return ret;
+        }
+
+        auto lru = cell_indices.end();
+        std::uint64_t lru_time = 0;
+        for (auto it = cell_indices.begin(); it != cell_indices.end(); it++)
+        {
+            const Font::Glyph *glyph = target->Find(it->first);
+            std::uint64_t time = glyph ? glyph->last_use : 0;
+            if (time > frame_start_use)
+                continue; // Used during this frame.
+            if (lru == cell_indices.end() || time < lru_time)
+            {
+                lru = it;
+                lru_time = time;
+            }
+        }
+        if (lru == cell_indices.end())
+            return -1;
+
+        int ret = lru->second;
+        target->Erase(lru->first);
+        cell_indices.erase(lru);
+        return ret;
+    }
+
+    void GlyphCache::DrawGlyph(Font::Glyph &glyph, int cell_index, const FontFile::GlyphData &glyph_data)
+    {
+        // `MaxGlyphSize()` should prevent this, but if a glyph is larger than a cell anyway, we cut it rather than overwrite the neighbors.
+        ivec2 size(std::min(glyph_data.image.Size().x, cell_size.x), std::min(glyph_data.image.Size().y, cell_size.y));
+
+        Image cell(cell_size, u8vec4(0));
+        for (int y = 0; y < size.y; y++)
+        {
+            const u8vec4 *source_row = &glyph_data.image.UnsafeAt(ivec2(0, y));
+            std::copy(source_row, source_row + size.x, &cell.UnsafeAt(ivec2(0, y)));
+        }
+
+        ivec2 pos = CellPos(cell_index);
+        image->UnsafeDrawImage(cell, pos);
+
+        glyph.texture_pos = pos;
+        glyph.size = size;
+        glyph.offset = glyph_data.offset;
+        glyph.advance = glyph_data.advance;
+
+        if (upload_func)
+            upload_func(pos, cell);
+    }
+
+    bool GlyphCache::Load(uint32_t ch)
+    {
+        // The default glyph is handled separately.
+        if (ch == Unicode::default_char || missing_chars.count(ch))
+            return false;
+
+        const FontFile &font = Source();
+        if (!font.HasGlyph(ch))
+        {
+            missing_chars.insert(ch);
+            return false;
+        }
+
+        // Not adding the character to `missing_chars`, we can try again next frame.
+        int cell_index = AllocateCell();
+        if (cell_index == -1)
+            return false;
+
+        FontFile::GlyphData glyph_data = font.GetGlyph(ch, render_flags);
+        DrawGlyph(target->Insert(ch), cell_index, glyph_data);
+        cell_indices.insert({ch, cell_index});
+        return true;
+    }
+
+    bool GlyphCache::LoadCacheFile(const std::string &cache_file_name, std::uint64_t font_file_hash, const std::string &prewarm_chars)
+    {
+        CachedFont cached;
+        std::vector<std::uint8_t> alpha;
+
+        try
+        {
+            Stream::Input input(cache_file_name);
+            if (!input.DiscardChars<Stream::if_present>(cache_magic, std::strlen(cache_magic)))
+                Program::Error("Not a glyph cache.");
+            if (input.ReadLittle<std::uint32_t>() != cache_version)
+                Program::Error("Wrong glyph cache version.");
+            Refl::FromBinary(cached, input);
+
+            if (cached.font_file_hash != font_file_hash || cached.font_size != font_size || cached.render_flags != int(render_flags) || cached.flags != int(flags)
+                || cached.prewarm_chars != prewarm_chars)
+                return false;
+
+            // Validate the data, so that nothing can fail after we start modifying the cache.
+            if ((cached.cell_size < 1).any())
+                Program::Error("Invalid cell size in the glyph cache.");
+
+            std::size_t pixel_count = 0;
+            auto CountPixels = [&](const CachedGlyph &glyph)
+            {
+                if ((glyph.size < 0).any())
+                    Program::Error("Invalid glyph size in the glyph cache.");
+                pixel_count += glyph.size.prod();
+            };
+            if (cached.has_default_glyph)
+                CountPixels(cached.default_glyph);
+            for (std::size_t i = 0; i < cached.glyphs.size(); i++)
+            {
+                if (i > 0 && cached.glyphs[i].ch <= cached.glyphs[i-1].ch)
+                    Program::Error("The glyphs in the glyph cache are not sorted.");
+                CountPixels(cached.glyphs[i]);
+            }
+
+            const std::uint8_t *alpha_begin = cached.alpha.data(), *alpha_end = alpha_begin + cached.alpha.size();
+            if (Archive::UncompressedSize(alpha_begin, alpha_end) != pixel_count)
+                Program::Error("Invalid pixel count in the glyph cache.");
+            alpha.resize(pixel_count);
+            Archive::Uncompress(alpha_begin, alpha_end, alpha.data());
+        }
+        catch (...)
+        {
+            return false;
+        }
+
+        Init(cached.ascent, cached.descent, cached.line_skip, cached.cell_size, cached.has_kerning);
+
+        const std::uint8_t *next_alpha = alpha.data();
+        auto MakeGlyphData = [&](const CachedGlyph &glyph)
+        {
+            FontFile::GlyphData ret;
+            ret.image = Image(glyph.size);
+            for (int y = 0; y < glyph.size.y; y++)
+            for (int x = 0; x < glyph.size.x; x++)
+                ret.image.UnsafeAt(ivec2(x,y)) = u8vec3(255).to_vec4(*next_alpha++);
+            ret.offset = glyph.offset;
+            ret.advance = glyph.advance;
+            return ret;
+        };
+
+        if (cached.has_default_glyph)
+            DrawGlyph(target->DefaultGlyph(), AllocateCell(), MakeGlyphData(cached.default_glyph));
+
+        for (const CachedGlyph &glyph : cached.glyphs)
+        {
+            FontFile::GlyphData glyph_data = MakeGlyphData(glyph);
+            int cell_index = AllocateCell();
+            DrawGlyph(target->Insert(glyph.ch), cell_index, glyph_data);
+            cell_indices.insert({glyph.ch, cell_index});
+        }
+
+        missing_chars.insert(cached.missing_chars.begin(), cached.missing_chars.end());
+
+        for (const CachedKerningPair &pair : cached.kerning_pairs)
+            cached_kerning.insert({KerningKey(pair.a, pair.b), pair.kerning});
+        for (uint32_t ch : UniqueChars(prewarm_chars))
+            cached_kerning_chars.insert(ch);
+
+        return true;
+    }
+
+    void GlyphCache::SaveCacheFile(const std::string &cache_file_name, std::uint64_t font_file_hash, const std::string &prewarm_chars)
+    {
+        const FontFile &font = Source();
+
+        CachedFont cached;
+        cached.font_file_hash = font_file_hash;
+        cached.font_size = font_size;
+        cached.render_flags = render_flags;
+        cached.flags = flags;
+        cached.prewarm_chars = prewarm_chars;
+
+        cached.ascent = target->Ascent();
+        cached.descent = target->Descent();
+        cached.line_skip = target->LineSkip();
+        cached.cell_size = cell_size;
+
+        std::vector<std::uint8_t> alpha;
+        auto MakeCachedGlyph = [&](uint32_t ch, const Font::Glyph &glyph)
+        {
+            CachedGlyph ret;
+            ret.ch = ch;
+            ret.size = glyph.size;
+            ret.offset = glyph.offset;
+            ret.advance = glyph.advance;
+            for (int y = 0; y < glyph.size.y; y++)
+            for (int x = 0; x < glyph.size.x; x++)
+                alpha.push_back(image->UnsafeAt(glyph.texture_pos + ivec2(x,y)).a);
+            return ret;
+        };
+
+        cached.has_default_glyph = font.HasGlyph(Unicode::default_char);
+        if (cached.has_default_glyph)
+            cached.default_glyph = MakeCachedGlyph(Unicode::default_char, target->DefaultGlyph());
+
+        std::vector<uint32_t> chars = UniqueChars(prewarm_chars);
+        for (uint32_t ch : chars)
+        {
+            // If there are more pre-warm characters than cells, some of them could've been evicted already.
+            if (cell_indices.count(ch))
+                cached.glyphs.push_back(MakeCachedGlyph(ch, *target->Find(ch)));
+            else if (missing_chars.count(ch))
+                cached.missing_chars.push_back(ch);
+        }
+
+        cached.has_kerning = font.HasKerning();
+        if (cached.has_kerning)
+        {
+            for (uint32_t a : chars)
+            for (uint32_t b : chars)
+            {
+                if (int kerning = font.Kerning(a, b))
+                    cached.kerning_pairs.push_back({a, b, kerning});
+            }
+        }
+
+        cached.alpha.resize(Archive::MaxCompressedSize(alpha.data(), alpha.data() + alpha.size()));
+        std::uint8_t *alpha_end = Archive::Compress(alpha.data(), alpha.data() + alpha.size(), cached.alpha.data(), cached.alpha.data() + cached.alpha.size());
+        cached.alpha.resize(alpha_end - cached.alpha.data());
+
+        Stream::Output output(cache_file_name);
+        output.WriteString(cache_magic);
+        output.WriteLittle<std::uint32_t>(cache_version);
+        Refl::ToBinary(cached, output);
+        output.Flush();
+    }
+
+    GlyphCache::GlyphCache(Font &font, Stream::ReadOnlyData font_file, int font_size, FontFile::RenderFlags render_flags, Image &image, ivec2 pos, ivec2 size, Flags flags,
+                           const std::string &prewarm_chars, const std::string &cache_file_name)
+        : target(&font), font_file(std::move(font_file)), font_size(font_size), render_flags(render_flags), flags(flags), image(&image), region_pos(pos), region_size(size)
+    {
+        if (!image.RectInBounds(pos, size))
+            Program::Error("Invalid target rectangle for a glyph cache.");
+
+        image.UnsafeFill(pos, size, u8vec4(0));
+
+        std::uint64_t font_file_hash = 0;
+        bool cache_loaded = false;
+        if (cache_file_name.size() > 0)
+        {
+            font_file_hash = Hash::Bytes(this->font_file.data(), this->font_file.size());
+            cache_loaded = LoadCacheFile(cache_file_name, font_file_hash, prewarm_chars);
+        }
+
+        if (!cache_loaded)
+            InitFromSource();
+
+        font.SetMissingGlyphFunc([this](uint32_t ch){return Load(ch);});
+
+        if (!cache_loaded)
+        {
+            Prewarm(prewarm_chars);
+
+            if (cache_file_name.size() > 0)
+            {
+                try
+                {
+                    SaveCacheFile(cache_file_name, font_file_hash, prewarm_chars);
+                }
+                catch (...) {}
+            }
+        }
+    }
+
+    void GlyphCache::Prewarm(const std::string &chars)
+    {
+        // Not using `Font::Get()`, since it would mark the glyphs as used during this frame.
+        for (uint32_t ch : Unicode::Iterator(chars))
+        {
+            if (!target->Find(ch))
+                Load(ch);
+        }
+    }
+
+    std::string GlyphCache::ReadPrewarmList(const std::string &file_name)
+    {
+        std::string ret;
+        try
+        {
+            Stream::ReadOnlyData file(file_name);
+            ret.assign(reinterpret_cast<const char *>(file.data()), file.size());
+        }
+        catch (...)
+        {
+            ret.clear();
+            for (char ch = ' '; ch <= '~'; ch++)
+                ret += ch;
+        }
+        return ret;
+    }
+
+    void GlyphCache::SavePrewarmList(const std::string &file_name) const
+    {
+        std::vector<uint32_t> chars;
+        chars.reserve(cell_indices.size());
+        for (const auto &elem : cell_indices)
+            chars.push_back(elem.first);
+        std::sort(chars.begin(), chars.end());
+
+        std::string str;
+        for (uint32_t ch : chars)
+            Unicode::Encode(ch, str);
+
+        try
+        {
+            Stream::SaveFile(file_name, str);
+        }
+        catch (...) {}
+    }
+}
@@ -0,0 +1,144 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+#include "graphics/font_file.h"
+#include "graphics/font.h"
+#include "graphics/image.h"
+#include "stream/readonly_data.h"
+#include "utils/mat.h"
+
+namespace Graphics
+{
+    // Rasterizes the glyphs of a font on first use, instead of prerendering whole character ranges with `MakeFontAtlas()`.
+    // The glyphs are drawn into a region of an image, which is split into equal cells large enough for any glyph of the font.
+    // When all cells are taken, the least recently used glyph is evicted. `Text` looks the glyphs up again when drawn, so it doesn't care if they move.
+    // Glyphs used since the last `NewFrame()` call are never evicted, since the quads already queued for rendering refer to them.
+    // If all glyphs are in use, the new ones are drawn as the default glyph until the next frame.
+    //
+    // The "pre-warm" characters are rasterized immediately. The set of cached characters can be saved with `SavePrewarmList()`, to pre-warm them next time.
+    // Optionally the pre-warmed glyphs are saved to a cache file, along with the font metrics and the kerning between them.
+    // If the cache file matches the font file, the size, the flags and the pre-warm characters, it's loaded instead, and FreeType isn't used at all
+    // until a glyph outside of the pre-warm set is needed.
+    class GlyphCache
+    {
+      public:
+        enum Flags
+        {
+            none        = 0,
+            no_line_gap = 0b1, // Same as `FontAtlasEntry::no_line_gap`.
+        };
+        friend constexpr Flags operator|(Flags a, Flags b) {return Flags(int(a) | int(b));}
+        friend constexpr Flags operator&(Flags a, Flags b) {return Flags(int(a) & int(b));}
+
+        // Called after a glyph is drawn into the image, to update the texture. `cell` is a copy of the changed part of the image, located at `pos`.
+        // Normally it's `texture.SetDataPart(pos, cell.Size(), cell.Data())`.
+        using upload_func_t = std::function<void(ivec2 pos, const Image &cell)>;
+
+      private:
+        Font *target = 0;
+        Stream::ReadOnlyData font_file;
+        int font_size = 0;
+        std::optional<FontFile> source; // Opened on demand, see `Source()`.
+        FontFile::RenderFlags render_flags = FontFile::none;
+        Flags flags = none;
+
+        Image *image = 0;
+        ivec2 region_pos = ivec2(0);
+        ivec2 region_size = ivec2(0);
+        ivec2 cell_size = ivec2(0); // Not including the gap.
+        ivec2 cell_count = ivec2(0);
+
+        std::vector<int> free_cells; // The last cell is used first.
+        std::unordered_map<uint32_t, int> cell_indices; // Doesn't include the default glyph, which is never evicted.
+        std::unordered_set<uint32_t> missing_chars; // The characters the font doesn't have, so that we don't look for them again.
+        std::uint64_t frame_start_use = 0; // `Font::UseCounter()` at the last `NewFrame()` call. Glyphs used after that can't be evicted.
+
+        // If the cache file was loaded, this has the kerning between the pre-warm characters, so that we don't need FreeType for it. Zeroes are not stored.
+        std::unordered_map<std::uint64_t, int> cached_kerning;
+        std::unordered_set<uint32_t> cached_kerning_chars;
+
+        upload_func_t upload_func;
+
+        // Opens the font file with FreeType, if it's not open yet.
+        const FontFile &Source();
+
+        // Sets the font metrics and splits the region into cells.
+        void Init(int ascent, int descent, int line_skip, ivec2 new_cell_size, bool has_kerning);
+        void InitFromSource();
+
+        ivec2 CellPos(int index) const
+        {
+            // There is a one pixel gap between the cells, same as in `MakeFontAtlas()`.
+            return region_pos + ivec2(index % cell_count.x, index / cell_count.x) * (cell_size + 1);
+        }
+
+        // Returns a free cell, evicting the least recently used glyph if there are none.
+        // Returns -1 if all glyphs were used during this frame.
+        int AllocateCell();
+
+        void DrawGlyph(Font::Glyph &glyph, int cell_index, const FontFile::GlyphData &glyph_data);
+
+        bool Load(uint32_t ch);
+
+        // Returns false if the cache file is missing, invalid, or doesn't match the font and the pre-warm characters.
+        bool LoadCacheFile(const std::string &cache_file_name, std::uint64_t font_file_hash, const std::string &prewarm_chars);
+        void SaveCacheFile(const std::string &cache_file_name, std::uint64_t font_file_hash, const std::string &prewarm_chars);
+
+      public:
+        // Throws on failure. Sets the font metrics, and rasterizes the default glyph and the `prewarm_chars` (a UTF-8 string).
+        // `pos` and `size` are the region of `image` reserved for the glyphs. The region is cleared.
+        // If `cache_file_name` is not empty, the pre-warmed glyphs are loaded from that file if possible, otherwise the file is (re)generated.
+        GlyphCache(Font &font, Stream::ReadOnlyData font_file, int font_size, FontFile::RenderFlags render_flags, Image &image, ivec2 pos, ivec2 size, Flags flags = none,
+                   const std::string &prewarm_chars = "", const std::string &cache_file_name = "");
+
+        // The font refers to the cache, so it can't be copied or moved.
+        GlyphCache(const GlyphCache &) = delete;
+        GlyphCache &operator=(const GlyphCache &) = delete;
+
+        ~GlyphCache()
+        {
+            target->SetMissingGlyphFunc(0);
+            target->SetKerningFunc(0);
+        }
+
+        void SetUploadFunc(upload_func_t new_upload_func)
+        {
+            upload_func = std::move(new_upload_func);
+        }
+
+        [[nodiscard]] int GlyphCount() const
+        {
+            return cell_indices.size();
+        }
+        [[nodiscard]] int Capacity() const // Not including the default glyph.
+        {
+            return cell_count.prod() - 1;
+        }
+        [[nodiscard]] bool UsesFreeType() const // Returns false if all glyphs so far came from the cache file.
+        {
+            return bool(source);
+        }
+
+        // Call this once per frame, before rendering. Allows the glyphs used before this call to be evicted.
+        void NewFrame()
+        {
+            frame_start_use = target->UseCounter();
+        }
+
+        // Rasterizes the glyphs for the characters in the UTF-8 string `chars`, so they don't have to be rasterized later.
+        void Prewarm(const std::string &chars);
+
+        // Reads the characters saved by `SavePrewarmList()`. If the file can't be read, returns the printable ASCII characters instead.
+        [[nodiscard]] static std::string ReadPrewarmList(const std::string &file_name);
+        // Saves the currently cached characters as a UTF-8 string. Errors are ignored, since the list is only an optimization.
+        void SavePrewarmList(const std::string &file_name) const;
+    };
+}
@@ -37,15 +37,21 @@ namespace Graphics
         {
             data = std::vector<u8vec4>(size.prod(), color);
         }
-        Image(Stream::ReadOnlyData file, FlipMode flip_mode = no_flip) // Throws on failure.
+        Image(Stream::ReadOnlyData file, FlipMode flip_mode = no_flip) // Throws on failure. Can be called from several threads at once.
         {
-            stbi_set_flip_vertically_on_load(flip_mode == flip_y);
+            // We don't use `stbi_set_flip_vertically_on_load()`, because it sets a global variable.
             ivec2 img_size;
             uint8_t *bytes = stbi_load_from_memory(file.data(), file.size(), &img_size.x, &img_size.y, 0, 4);
             if (!bytes)
                 Program::Error("Unable to parse image: ", file.name());
             FINALLY( stbi_image_free(bytes); )
             *this = Image(img_size, bytes);
+
+            if (flip_mode == flip_y)
+            {
+                for (int y = 0; y < size.y / 2; y++)
+                    std::swap_ranges(&UnsafeAt(ivec2(0, y)), &UnsafeAt(ivec2(0, y)) + size.x, &UnsafeAt(ivec2(0, size.y - 1 - y)));
+            }
         }
 
         explicit operator bool() const {return data.size() > 0;}
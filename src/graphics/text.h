@@ -16,6 +16,7 @@ namespace Graphics
         struct Symbol
         {
             uint32_t ch = 0;
+            const Font *font = 0; // If not null, the glyph is looked up in this font again when drawing, because a `GlyphCache` can move it.
             svec2 texture_pos = ivec2(0);
             svec2 offset = ivec2(0);
             svec2 size = ivec2(0);
@@ -132,6 +133,7 @@ namespace Graphics
                 const Font::Glyph &glyph = font.Get(ch);
                 Symbol symbol;
                 symbol.ch = ch;
+                symbol.font = &font;
                 symbol.texture_pos = glyph.texture_pos;
                 symbol.offset = glyph.offset;
                 symbol.size = glyph.size;
@@ -4,7 +4,9 @@
 
 #include "stream/readonly_data.h"
 #include "stream/save_to_file.h"
+#include "utils/hash.h"
 #include "utils/packing.h"
+#include "utils/parallel.h"
 
 namespace Graphics
 {
@@ -86,23 +88,17 @@ namespace Graphics
 
         // Begin regenerating atlas.
 
-        // Count images.
-        int image_count = 0;
-        Filesystem::ForEachObject(source_tree, [&](const Filesystem::TreeNode &node)
-        {
-            if (node.info.category != Filesystem::file)
-                return;
-            image_count++;
-        });
-
-        // Load images.
+        // Collect the source files.
         struct Elem
         {
             std::string name;
-            Image image;
+            const std::string *path = nullptr;
+            Stream::ReadOnlyData file;
+            std::uint64_t hash = 0;
+            Image image; // Only decoded if the image has to be drawn.
+            ImageDesc desc;
         };
         std::vector<Elem> elem_list;
-        elem_list.reserve(image_count);
 
         Filesystem::ForEachObject(source_tree, [&](const Filesystem::TreeNode &node)
         {
@@ -113,37 +109,180 @@ namespace Graphics
 
             // Save image name, but first strip source directory name from it.
             new_elem.name = node.path.substr(source_dir.size() + 1); // `+ 1` is for `/`.
-
-            // Load image.
-            new_elem.image = Image(node.path);
+            new_elem.path = &node.path;
         });
 
         // Sort images by name. Otherwise the order sometimes turns out different on different platforms.
         std::sort(elem_list.begin(), elem_list.end(), [](const Elem &a, const Elem &b){return a.name < b.name;});
 
-        // Construct rectangle list for packing.
-        std::vector<Packing::Rect> rect_list;
-        rect_list.reserve(image_count);
-        for (const Elem &elem : elem_list)
-            rect_list.push_back(elem.image.Size());
+        // Read and hash the files in parallel.
+        ParallelFor(elem_list.size(), [&](std::size_t i)
+        {
+            Elem &elem = elem_list[i];
+            elem.file = Stream::ReadOnlyData(*elem.path);
+            elem.hash = Hash::Bytes(elem.file.data(), elem.file.size());
+        });
 
-        // Try packing rectangles.
-        if (Packing::PackRects(target_size, rect_list.data(), rect_list.size(), add_gaps))
-            Program::Error("Unable to fit texture atlas for `", source_dir, "` into a ", target_size.x, 'x', target_size.y, " texture.");
+        // Decodes the images that weren't decoded yet, in parallel. This is the slowest part.
+        auto DecodeImages = [&](const std::vector<Elem *> &list)
+        {
+            ParallelFor(list.size(), [&](std::size_t i)
+            {
+                list[i]->image = Image(list[i]->file);
+            });
+        };
 
-        // Construct description and final image.
-        image = Image(target_size, u8vec4(0));
-        for (size_t i = 0; i < elem_list.size(); i++)
+        // Tries to update the existing atlas in place, redrawing only the changed images and keeping the rest where they were.
+        // Returns false if the existing atlas can't be loaded, or if the changed images don't fit into the free space. Then the atlas is rebuilt from scratch.
+        auto UpdateIncrementally = [&]() -> bool
         {
-            // Add image to description.
-            ImageDesc image_desc;
-            image_desc.pos = rect_list[i].pos;
-            image_desc.size = elem_list[i].image.Size(); // Note that we don't extract sizes from rectangles, since those sizes might include gap size.
-            if (!desc.images.insert({std::move(elem_list[i].name), image_desc}).second)
-                Program::Error("Internal error while generating description for texture atlas for `", source_dir, "`: Duplicate image paths.");
+            Image old_image;
+            Desc old_desc;
+            try
+            {
+                old_image = Image(out_image_file);
+                old_desc = Refl::FromString<Desc>(Stream::Input(out_desc_file));
+            }
+            catch (...)
+            {
+                return false;
+            }
+
+            if (old_image.Size() != target_size || old_desc.gaps != int(add_gaps))
+                return false;
+
+            std::vector<Elem *> changed_elems;
+            std::vector<Packing::Rect> occupied_rects;
+            for (Elem &elem : elem_list)
+            {
+                auto it = old_desc.images.find(elem.name);
+                if (it != old_desc.images.end())
+                {
+                    elem.desc = it->second;
+                    if (elem.desc.hash == elem.hash)
+                    {
+                        occupied_rects.push_back(Packing::Rect(elem.desc.size));
+                        occupied_rects.back().pos = elem.desc.pos;
+                        old_desc.images.erase(it);
+                        continue;
+                    }
+                }
+                changed_elems.push_back(&elem);
+            }
+
+            // If most of the images have changed, a full rebuild is cheap enough and packs the images better.
+            if (changed_elems.size() * 2 > elem_list.size())
+                return false;
+
+            DecodeImages(changed_elems);
+
+            // If a changed image kept its size, it's drawn in the same place. Otherwise it needs a new place.
+            std::vector<Elem *> moved_elems;
+            std::vector<Packing::Rect> moved_rects;
+            for (Elem *elem : changed_elems)
+            {
+                auto it = old_desc.images.find(elem->name);
+                if (it != old_desc.images.end() && it->second.size == elem->image.Size())
+                {
+                    occupied_rects.push_back(Packing::Rect(elem->desc.size));
+                    occupied_rects.back().pos = elem->desc.pos;
+                    old_desc.images.erase(it);
+                }
+                else
+                {
+                    moved_elems.push_back(elem);
+                    moved_rects.push_back(Packing::Rect(elem->image.Size()));
+                }
+            }
+
+            if (Packing::PackRectsIntoFreeSpace(target_size, occupied_rects.data(), occupied_rects.size(), moved_rects.data(), moved_rects.size(), add_gaps))
+                return false;
 
-            // Copy this image to target image.
-            image.UnsafeDrawImage(elem_list[i].image, image_desc.pos);
+            for (std::size_t i = 0; i < moved_elems.size(); i++)
+                moved_elems[i]->desc.pos = moved_rects[i].pos;
+
+            // Clear the images that were removed or moved. This must happen before drawing, since the new images can reuse their space.
+            for (const auto &[name, old_image_desc] : old_desc.images)
+            {
+                for (int y = 0; y < old_image_desc.size.y; y++)
+                {
+                    u8vec4 *row = &old_image.UnsafeAt(ivec2(old_image_desc.pos.x, old_image_desc.pos.y + y));
+                    std::fill(row, row + old_image_desc.size.x, u8vec4(0));
+                }
+            }
+
+            image = std::move(old_image);
+            for (Elem *elem : changed_elems)
+            {
+                for (int y = 0; y < elem->image.Size().y; y++)
+                {
+                    const u8vec4 *source_row = &elem->image.UnsafeAt(ivec2(0, y));
+                    std::copy(source_row, source_row + elem->image.Size().x, &image.UnsafeAt(ivec2(elem->desc.pos.x, elem->desc.pos.y + y)));
+                }
+            }
+
+            return true;
+        };
+
+        if (!UpdateIncrementally())
+        {
+            // Rebuild the atlas from scratch.
+            std::vector<Elem *> elems_to_decode;
+            for (Elem &elem : elem_list)
+            {
+                if (!elem.image.Size().all())
+                    elems_to_decode.push_back(&elem);
+            }
+            DecodeImages(elems_to_decode);
+
+            // Construct rectangle list for packing.
+            std::vector<Packing::Rect> rect_list;
+            rect_list.reserve(elem_list.size());
+            for (const Elem &elem : elem_list)
+                rect_list.push_back(elem.image.Size());
+
+            // Try packing rectangles.
+            if (Packing::PackRectsWithBestHeuristic(target_size, rect_list.data(), rect_list.size(), add_gaps))
+                Program::Error("Unable to fit texture atlas for `", source_dir, "` into a ", target_size.x, 'x', target_size.y, " texture.");
+
+            for (std::size_t i = 0; i < elem_list.size(); i++)
+                elem_list[i].desc.pos = rect_list[i].pos;
+
+            // Construct final image.
+            // It's split into horizontal bands, and each thread copies the parts of the images that intersect its band.
+            image = Image(target_size, u8vec4(0));
+            std::size_t band_count = ParallelThreadCount();
+            ParallelFor(band_count, [&](std::size_t band)
+            {
+                int band_begin = target_size.y * band / band_count;
+                int band_end = target_size.y * (band + 1) / band_count;
+
+                for (const Elem &elem : elem_list)
+                {
+                    const Image &source = elem.image;
+                    ivec2 pos = elem.desc.pos;
+
+                    int y_begin = max(band_begin, pos.y);
+                    int y_end = min(band_end, pos.y + source.Size().y);
+                    for (int y = y_begin; y < y_end; y++)
+                    {
+                        const u8vec4 *source_row = &source.UnsafeAt(ivec2(0, y - pos.y));
+                        std::copy(source_row, source_row + source.Size().x, &image.UnsafeAt(ivec2(pos.x, y)));
+                    }
+                }
+            });
+        }
+
+        // Construct description.
+        desc.gaps = add_gaps;
+        for (Elem &elem : elem_list)
+        {
+            // Note that the unchanged images are not decoded, so their size comes from the old description.
+            if (elem.image.Size().any())
+                elem.desc.size = elem.image.Size();
+            elem.desc.hash = elem.hash;
+            if (!desc.images.insert({std::move(elem.name), elem.desc}).second)
+                Program::Error("Internal error while generating description for texture atlas for `", source_dir, "`: Duplicate image paths.");
         }
 
         // Save final image.
@@ -161,4 +300,20 @@ namespace Graphics
         }
         catch (...) {}
     }
+
+    std::string TextureAtlas::OccupancyReport() const
+    {
+        long long used_area = 0;
+        int used_height = 0;
+        for (const auto &[name, image_desc] : desc.images)
+        {
+            used_area += (long long)image_desc.size.x * image_desc.size.y;
+            clamp_var_min(used_height, image_desc.pos.y + image_desc.size.y);
+        }
+
+        ivec2 size = image.Size();
+        long long area = (long long)size.x * size.y;
+        return Str(size.x, 'x', size.y, ": ", desc.images.size(), " images, ", (area ? used_area * 100 / area : 0), "% used, ", area - used_area, " pixels wasted, ",
+            size.y - used_height, " rows free at the bottom.\n");
+    }
 }
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <cstdint>
 #include <ctime>
 #include <map>
 #include <string>
@@ -20,9 +21,11 @@ namespace Graphics
     {
         REFL_SIMPLE_STRUCT_WITHOUT_NAMES( ImageDesc
             REFL_DECL(ivec2) pos, size
+            REFL_DECL(std::uint64_t REFL_INIT=0) hash // `Hash::Bytes()` of the source file, used to detect changed images when updating the atlas.
         )
 
         REFL_SIMPLE_STRUCT( Desc
+            REFL_DECL(int REFL_INIT=0) gaps // The atlas is only updated incrementally if this matches the requested gap size.
             REFL_DECL(std::map<std::string, ImageDesc>) images
         )
 
@@ -94,6 +97,9 @@ namespace Graphics
             return image;
         }
 
+        // Returns a human-readable summary of how densely the images are packed.
+        [[nodiscard]] std::string OccupancyReport() const;
+
         bool GetOpt(const std::string &name, Region &target) const // Returns false if no such image.
         {
             auto it = desc.images.find(name);
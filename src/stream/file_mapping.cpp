@@ -0,0 +1,85 @@
+#include "file_mapping.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+
+#ifdef _WIN32
+#  include <filesystem>
+#  include <windows.h>
+#else
+#  include <fcntl.h>
+#  include <sys/mman.h>
+#  include <sys/stat.h>
+#  include <unistd.h>
+#endif
+
+#include "macros/finally.h"
+
+namespace Stream
+{
+    FileMapping FileMapping::TryOpen(const std::string &file_name)
+    {
+        FileMapping ret;
+
+        #ifdef _WIN32
+        HANDLE file = CreateFileW(std::filesystem::u8path(file_name).c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (file == INVALID_HANDLE_VALUE)
+            return ret;
+        FINALLY( CloseHandle(file); )
+
+        if (GetFileType(file) != FILE_TYPE_DISK)
+            return ret;
+
+        LARGE_INTEGER size;
+        if (!GetFileSizeEx(file, &size) || size.QuadPart <= 0 || std::uint64_t(size.QuadPart) > std::uint64_t(std::numeric_limits<std::ptrdiff_t>::max()))
+            return ret;
+
+        HANDLE mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if (!mapping)
+            return ret;
+        FINALLY( CloseHandle(mapping); ) // The view keeps the mapping alive.
+
+        void *view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+        if (!view)
+            return ret;
+
+        ret.begin = static_cast<const std::uint8_t *>(view);
+        ret.size = std::size_t(size.QuadPart);
+        #else
+        int file = open(file_name.c_str(), O_RDONLY);
+        if (file == -1)
+            return ret;
+        FINALLY( close(file); ) // The mapping stays valid after this.
+
+        struct stat info;
+        if (fstat(file, &info) || !S_ISREG(info.st_mode) || info.st_size <= 0 || std::uintmax_t(info.st_size) > std::uintmax_t(std::numeric_limits<std::ptrdiff_t>::max()))
+            return ret;
+
+        void *view = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, file, 0);
+        if (view == MAP_FAILED)
+            return ret;
+
+        // We usually read the whole file from start to end.
+        madvise(view, info.st_size, MADV_SEQUENTIAL);
+
+        ret.begin = static_cast<const std::uint8_t *>(view);
+        ret.size = std::size_t(info.st_size);
+        #endif
+
+        return ret;
+    }
+
+    FileMapping::~FileMapping()
+    {
+        if (!begin)
+            return;
+
+        // We don't check for errors here, since there is nothing we could do.
+        #ifdef _WIN32
+        UnmapViewOfFile(begin);
+        #else
+        munmap(const_cast<std::uint8_t *>(begin), size);
+        #endif
+    }
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <utility>
+
+namespace Stream
+{
+    // A read-only memory mapping of an entire file.
+    // If the file is modified while it's mapped, the behavior is undefined.
+    class FileMapping
+    {
+        const std::uint8_t *begin = nullptr;
+        std::size_t size = 0;
+
+      public:
+        FileMapping() {}
+
+        // Returns a null mapping if the file can't be mapped. This happens for empty files and for anything that's not a regular file, such as pipes.
+        // Never throws, the caller is expected to fall back to regular reads (which will report an error if the file can't be opened at all).
+        [[nodiscard]] static FileMapping TryOpen(const std::string &file_name);
+
+        FileMapping(FileMapping &&other) noexcept : begin(std::exchange(other.begin, nullptr)), size(std::exchange(other.size, 0)) {}
+        FileMapping &operator=(FileMapping other) noexcept
+        {
+            std::swap(begin, other.begin);
+            std::swap(size, other.size);
+            return *this;
+        }
+
+        ~FileMapping();
+
+        [[nodiscard]] explicit operator bool() const
+        {
+            return bool(begin);
+        }
+
+        [[nodiscard]] const std::uint8_t *data() const
+        {
+            return begin;
+        }
+        [[nodiscard]] std::size_t data_size() const
+        {
+            return size;
+        }
+    };
+}
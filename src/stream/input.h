@@ -1,6 +1,7 @@
 #pragma once
 
 #include <algorithm>
+#include <array>
 #include <cstddef>
 #include <cstdint>
 #include <cstdio>
@@ -11,6 +12,7 @@
 #include <string>
 #include <type_traits>
 #include <utility>
+#include <vector>
 
 #include "macros/check.h"
 #include "meta/misc.h"
@@ -31,11 +33,44 @@ namespace Stream
 {
     namespace Char
     {
+        // A 256-entry lookup table for a character category.
+        class Table
+        {
+            std::array<bool, 256> entries{};
+
+          public:
+            constexpr Table() {}
+
+            // `func` is `bool func(char ch)`.
+            template <typename F>
+            [[nodiscard]] static constexpr Table FromFunc(F &&func)
+            {
+                Table ret;
+                for (int i = 0; i < 256; i++)
+                    ret.entries[i] = func(char(i));
+                return ret;
+            }
+
+            [[nodiscard]] constexpr bool operator()(char ch) const
+            {
+                return entries[(unsigned char)ch];
+            }
+        };
+
         // A base class for character categories.
         struct Category
         {
             [[nodiscard]] virtual bool operator()(char ch) const = 0;
             [[nodiscard]] virtual std::string name() const = 0;
+
+            // Returns a lookup table equivalent to this category, or null if there is none.
+            // `first` is true for the first character of a sequence. This only matters for categories such as `SeqIdentifier`.
+            // Input streams use the tables to scan large spans of characters at once, without calling `operator()` for each character.
+            [[nodiscard]] virtual const Table *GetTable(bool first) const
+            {
+                (void)first;
+                return nullptr;
+            }
         };
 
         // A category matching a single character.
@@ -78,18 +113,43 @@ namespace Stream
         };
 
 
+        // Constexpr equivalents of the functions from `<cctype>`, for the default "C" locale (which we never change).
+        namespace CLocale
+        {
+            [[nodiscard]] constexpr bool iscntrl (char ch) {unsigned char u = ch; return u < 32 || u == 127;}
+            [[nodiscard]] constexpr bool isprint (char ch) {unsigned char u = ch; return u >= 32 && u < 127;}
+            [[nodiscard]] constexpr bool isspace (char ch) {unsigned char u = ch; return u == ' ' || (u >= '\t' && u <= '\r');}
+            [[nodiscard]] constexpr bool isblank (char ch) {unsigned char u = ch; return u == ' ' || u == '\t';}
+            [[nodiscard]] constexpr bool isgraph (char ch) {unsigned char u = ch; return u > 32 && u < 127;}
+            [[nodiscard]] constexpr bool isupper (char ch) {unsigned char u = ch; return u >= 'A' && u <= 'Z';}
+            [[nodiscard]] constexpr bool islower (char ch) {unsigned char u = ch; return u >= 'a' && u <= 'z';}
+            [[nodiscard]] constexpr bool isalpha (char ch) {return isupper(ch) || islower(ch);}
+            [[nodiscard]] constexpr bool isdigit (char ch) {unsigned char u = ch; return u >= '0' && u <= '9';}
+            [[nodiscard]] constexpr bool isxdigit(char ch) {unsigned char u = ch | 32; return isdigit(ch) || (u >= 'a' && u <= 'f');}
+            [[nodiscard]] constexpr bool isalnum (char ch) {return isalpha(ch) || isdigit(ch);}
+            [[nodiscard]] constexpr bool ispunct (char ch) {return isgraph(ch) && !isalnum(ch);}
+        }
+
+
         // Some character categories.
 
         #define CHAR_CATEGORY(class_name_, string_, expr_) \
             struct class_name_ final : Category \
             { \
-                [[nodiscard]] bool operator()(char ch) const override {return expr_;} \
+                [[nodiscard]] static constexpr bool Test(char ch) {return expr_;} \
+                [[nodiscard]] bool operator()(char ch) const override {return Test(ch);} \
                 [[nodiscard]] std::string name() const override {return string_;} \
+                [[nodiscard]] const Table *GetTable(bool first) const override \
+                { \
+                    (void)first; \
+                    static constexpr Table table = Table::FromFunc(Test); \
+                    return &table; \
+                } \
             };
 
         // Character categories corresponding to the functions from `<cctype>`:
 
-        #define CHAR_CATEGORY_STD(class_name_, func_, string_) CHAR_CATEGORY(class_name_, string_, std::func_((unsigned char)ch))
+        #define CHAR_CATEGORY_STD(class_name_, func_, string_) CHAR_CATEGORY(class_name_, string_, CLocale::func_(ch))
         // 0-31, 127
         CHAR_CATEGORY_STD( IsControl      , iscntrl  , "a control character"     )
         // !IsControl
@@ -135,6 +195,13 @@ namespace Stream
             }
 
             [[nodiscard]] std::string name() const override {return "an identifier";}
+
+            [[nodiscard]] const Table *GetTable(bool first) const override
+            {
+                static constexpr Table first_table = Table::FromFunc([](char ch){return CLocale::isalpha(ch) || ch == '_';});
+                static constexpr Table rest_table = Table::FromFunc([](char ch){return CLocale::isalnum(ch) || ch == '_';});
+                return first && first_char ? &first_table : &rest_table;
+            }
         };
     }
 
@@ -203,6 +270,14 @@ namespace Stream
             }
         };
 
+        // Remembers where the lines end, to quickly compute text positions for error messages.
+        struct LineIndex
+        {
+            std::vector<std::size_t> line_end_offsets; // Offsets of the bytes that start new lines. For two-byte line ends, the first byte.
+            std::size_t indexed_bytes = 0;
+            std::uint8_t prev_line_end = 0; // Same as in `Strings::SymbolPosition::State`.
+        };
+
         struct Data
         {
             std::size_t buffer_capacity = -1; // This MUST be a power of two. 0 means that the stream is null.
@@ -215,6 +290,7 @@ namespace Stream
             std::size_t size = 0; // This value must be representable as `ptrdiff_t`.
 
             std::optional<LocationStyle> location_style;
+            LineIndex line_index; // Filled lazily by `GetLocation()`.
 
             std::string name;
 
@@ -322,6 +398,82 @@ namespace Stream
             return buffer;
         }
 
+        // Advances the cursor while `pred` matches the bytes, up to `max_count` bytes. Returns the amount of matched bytes.
+        // If `append_to` is not null, the matched bytes are appended to it.
+        // `pred` is `bool pred(char ch)`. Whole buffer segments are scanned at once, without checking bounds for every byte.
+        template <typename T, typename F>
+        std::size_t ScanMatchingBytes(F &&pred, std::size_t max_count, T append_to)
+        {
+            std::size_t count = 0;
+
+            while (count < max_count && MoreData())
+            {
+                std::size_t segment_offset = PositionToSegmentOffset(data.position);
+                const Buffer &buffer = NeedSegment(segment_offset);
+                std::size_t segment_end = segment_offset + std::min(data.size - segment_offset, data.buffer_capacity);
+
+                const std::uint8_t *begin = buffer.storage + (data.position - segment_offset);
+                const std::uint8_t *end = begin + std::min(segment_end - data.position, max_count - count);
+                const std::uint8_t *cur = begin;
+                while (cur != end && pred(char(*cur)))
+                    cur++;
+
+                if constexpr (!std::is_null_pointer_v<T>)
+                {
+                    if (append_to)
+                    {
+                        for (const std::uint8_t *it = begin; it != cur; it++)
+                            append_to->push_back(*it);
+                    }
+                }
+
+                std::size_t matched = cur - begin;
+                count += matched;
+                data.position += matched;
+
+                if (cur != end)
+                    break;
+            }
+
+            return count;
+        }
+
+        // Makes sure the line index covers at least the first `pos` bytes. Whole segments are indexed at once.
+        // This mirrors what `Strings::SymbolPosition` does with line ends, so `GetLocation()` can restart from any line end it finds here.
+        void IndexLinesUpTo(std::size_t pos)
+        {
+            LineIndex &index = data.line_index;
+
+            while (index.indexed_bytes < pos)
+            {
+                std::size_t segment_offset = PositionToSegmentOffset(index.indexed_bytes);
+                const Buffer &buffer = NeedSegment(segment_offset);
+                std::size_t segment_end = segment_offset + std::min(data.size - segment_offset, data.buffer_capacity);
+
+                for (std::size_t i = index.indexed_bytes; i < segment_end; i++)
+                {
+                    std::uint8_t byte = buffer.ReadByte(i);
+
+                    if (byte != '\n' && byte != '\r')
+                    {
+                        index.prev_line_end = 0;
+                        continue;
+                    }
+
+                    if (index.prev_line_end != 0 && byte != index.prev_line_end)
+                    {
+                        index.prev_line_end = 0;
+                        continue; // The second byte of a line end.
+                    }
+
+                    index.prev_line_end = byte;
+                    index.line_end_offsets.push_back(i);
+                }
+
+                index.indexed_bytes = segment_end;
+            }
+        }
+
         void ThrowIfNoData(std::size_t bytes)
         {
             if (data.position + bytes > data.size)
@@ -392,8 +544,16 @@ namespace Stream
         }
 
         // Attaches the stream to a file.
+        // Regular files are mapped to memory, then the stream works like the one created from a `ReadOnlyData`, and `buffer_capacity` is ignored.
+        // Other files (e.g. pipes) are read in segments through two buffers of size `buffer_capacity`.
         Input(std::string file_name, capacity_t buffer_capacity = default_capacity)
         {
+            if (ReadOnlyData mapped = ReadOnlyData::map_file(file_name))
+            {
+                *this = Input(std::move(mapped));
+                return;
+            }
+
             auto deleter = [](FILE *file)
             {
                 // We don't check for errors here, since there is nothing we could do.
@@ -470,7 +630,7 @@ namespace Stream
         }
 
         // Returns a string describing current location in the stream.
-        // This function can be costly for some location flavors, use it wisely.
+        // For text positions, the line ends are indexed once, then each call only rescans the current line.
         // It's not `const` because it might need to read parts of the file.
         [[nodiscard]] std::string GetLocation()
         {
@@ -486,12 +646,26 @@ namespace Stream
               case text_byte_position:
                 {
                     std::size_t old_pos = Position();
-                    Seek(0, absolute);
-                    FINALLY( Seek(old_pos, absolute); ) // Roll back to the original posiiton, in case we end up in the middle of a multibyte character, or something throws.
+
+                    // Find the last line end before the cursor, and count the symbols from it.
+                    // The line end itself is counted again, which restores the state of `SymbolPosition`.
+                    IndexLinesUpTo(old_pos);
+                    const std::vector<std::size_t> &line_ends = data.line_index.line_end_offsets;
+                    auto it = std::lower_bound(line_ends.begin(), line_ends.end(), old_pos);
 
                     Strings::SymbolPosition pos;
                     Strings::SymbolPosition::State pos_state;
 
+                    std::size_t start = 0;
+                    if (it != line_ends.begin())
+                    {
+                        start = it[-1];
+                        pos.line = int(it - line_ends.begin()); // Counting the line end will increment this.
+                    }
+
+                    Seek(start, absolute);
+                    FINALLY( Seek(old_pos, absolute); ) // Roll back to the original posiiton, in case we end up in the middle of a multibyte character, or something throws.
+
                     if (style == text_byte_position)
                     {
                         while (Position() < old_pos)
@@ -772,23 +946,21 @@ namespace Stream
         {
             constexpr bool several = mode == at_least_one || mode == any;
             constexpr bool throw_if_none = mode == at_least_one || mode == one;
+            constexpr std::size_t max_count = several ? std::size_t(-1) : 1;
 
             std::size_t count = 0;
 
-            do
+            if (const Char::Table *first_table = category.GetTable(true))
             {
-                if (!MoreData())
-                    break;
-                std::uint8_t byte = PeekByte();
-                if (!category(byte))
-                    break;
-                SkipOne();
-                if constexpr (!std::is_null_pointer_v<T>)
-                    if (append_to)
-                        append_to->push_back(byte);
-                count++;
+                // The first character is matched separately, since it can have a different table.
+                count = ScanMatchingBytes(*first_table, 1, append_to);
+                if (several && count == 1)
+                    count += ScanMatchingBytes(*category.GetTable(false), max_count - 1, append_to);
+            }
+            else
+            {
+                count = ScanMatchingBytes(category, max_count, append_to);
             }
-            while (several);
 
             if (throw_if_none && count == 0)
                 Program::Error(GetExceptionPrefix() + "Expected " + category.name() + ".");
@@ -798,7 +970,15 @@ namespace Stream
         template <ExtractMode mode = at_least_one, typename T, CHECK(impl::is_appendable_byte_seq_ptr_or_null_v<T>)>
         std::size_t Extract(std::uint8_t byte, T append_to)
         {
-            return Extract<mode>(Char::EqualTo(byte), append_to);
+            constexpr bool several = mode == at_least_one || mode == any;
+            constexpr bool throw_if_none = mode == at_least_one || mode == one;
+
+            std::size_t count = ScanMatchingBytes([byte](char ch){return std::uint8_t(ch) == byte;}, several ? std::size_t(-1) : 1, append_to);
+
+            if (throw_if_none && count == 0)
+                Program::Error(GetExceptionPrefix() + "Expected " + Char::EqualTo(byte).name() + ".");
+
+            return count;
         }
 
         // Reads matching characters from the input.
@@ -829,7 +1009,7 @@ namespace Stream
         template <ExtractMode mode = one>
         std::size_t Discard(std::uint8_t byte)
         {
-            return Extract<mode>(Char::EqualTo(byte), nullptr);
+            return Extract<mode>(byte, nullptr);
         }
 
         // Discards a sequence of bytes from the input.
@@ -13,6 +13,7 @@
 #include "macros/finally.h"
 #include "program/errors.h"
 #include "stream/better_fopen.h"
+#include "stream/file_mapping.h"
 #include "stream/utils.h"
 #include "strings/common.h"
 #include "utils/archive.h"
@@ -26,6 +27,7 @@ namespace Stream
         struct Data
         {
             std::unique_ptr<std::uint8_t[]> storage;
+            FileMapping mapping; // Either this or `storage` is set if we own the data.
 
             const std::uint8_t *begin = 0, *end = 0;
             bool extra_null_terminator = false; // If this is `true`, there is an extra null terminator past the `end`.
@@ -157,6 +159,25 @@ namespace Stream
             return ret;
         }
 
+        // Maps an entire file to memory, without copying it. Doesn't add a null-terminator.
+        // Returns a null object if the file can't be mapped (see `FileMapping::TryOpen()`), then you should fall back to reading it normally.
+        [[nodiscard]] static ReadOnlyData map_file(std::string file_name)
+        {
+            FileMapping mapping = FileMapping::TryOpen(file_name);
+            if (!mapping)
+                return {};
+
+            ReadOnlyData ret;
+            ret.ref = std::make_shared<Data>();
+
+            ret.ref->mapping = std::move(mapping);
+            ret.ref->begin = ret.ref->mapping.data();
+            ret.ref->end = ret.ref->begin + ret.ref->mapping.data_size();
+            ret.ref->name = std::move(file_name);
+
+            return ret;
+        }
+
         [[nodiscard]] explicit operator bool() const
         {
             return bool(ref);
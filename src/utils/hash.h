@@ -1,12 +1,14 @@
 #pragma once
 
 #include <cstddef>
+#include <cstdint>
 #include <functional>
 #include <initializer_list>
 #include <tuple>
 #include <utility>
 
 #include "meta/misc.h"
+#include "utils/byte_order.h"
 
 namespace Hash
 {
@@ -39,6 +41,34 @@ namespace Hash
     }
 
 
+    inline constexpr std::uint64_t bytes_seed = 0xcbf29ce484222325;
+
+    // FNV-1a. Unlike the other functions here, the result doesn't depend on the platform or the standard library, so it can be saved to files.
+    // To hash several pieces of data in a row, pass the previous result as `seed`.
+    [[nodiscard]] inline std::uint64_t Bytes(const void *data, std::size_t size, std::uint64_t seed = bytes_seed)
+    {
+        std::uint64_t ret = seed;
+        for (std::size_t i = 0; i < size; i++)
+        {
+            ret ^= static_cast<const std::uint8_t *>(data)[i];
+            ret *= 0x100000001b3;
+        }
+        return ret;
+    }
+
+    // Appends an arithmetic value to a `Bytes()` hash, in little-endian byte order. Use fixed-size types to get the same result on all platforms.
+    template <typename T> void AppendBytes(std::uint64_t &dst, T value)
+    {
+        value = ByteOrder::Little(value);
+        dst = Bytes(&value, sizeof value, dst);
+    }
+
+    template <typename ...P> void AppendBytes(std::uint64_t &dst, const P &... values)
+    {
+        (AppendBytes(dst, values), ...);
+    }
+
+
     namespace Custom
     {
         inline std::size_t hash(/* T &object */) = delete; // Overload this to provide custom hashes. You can also use ADL.
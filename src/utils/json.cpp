@@ -1,5 +1,7 @@
 #include "json.h"
 
+#include <algorithm>
+#include <cstdlib>
 #include <cstring>
 #include <limits>
 #include <ostream>
@@ -414,3 +416,380 @@ void Json::View::DebugPrint(std::ostream &stream) const
         break;
     }
 }
+
+
+Json::Reader::Reader(const char *string, int allowed_depth)
+    : begin(string), cur(string), max_depth(allowed_depth)
+{
+    path.reserve(max_depth + 1); // Plus one for `Revisit()`.
+}
+
+void Json::Reader::Error(std::string_view message) const
+{
+    std::string path_str;
+    for (const PathElem &elem : path)
+    {
+        if (elem.index >= 0)
+        {
+            path_str += '[';
+            path_str += std::to_string(elem.index);
+            path_str += ']';
+        }
+        else
+        {
+            if (!path_str.empty())
+                path_str += '.';
+            path_str += elem.key;
+        }
+    }
+
+    auto pos = Strings::GetSymbolPosition(begin, cur);
+    if (path_str.empty())
+        Program::Error("JSON parsing failed, at ", pos.ToString(), ": ", message);
+    else
+        Program::Error("JSON parsing failed, at ", pos.ToString(), ", in `", path_str, "`: ", message);
+}
+
+std::string_view Json::Reader::SkipStringRaw(bool &has_escapes)
+{
+    ParseSkipWhitespace(cur);
+
+    if (*cur != '"')
+        Error("Expected a string.");
+    cur++;
+
+    const char *str_begin = cur;
+    has_escapes = false;
+
+    while (*cur != '"')
+    {
+        if (*cur == '\0')
+        {
+            cur = str_begin; // We do this to get a better error message.
+            Error("This string lacks a terminating `\"` character.");
+        }
+        if (*cur > '\0' && *cur < ' ')
+            Error("Invalid character in a string.");
+
+        if (*cur == '\\')
+        {
+            has_escapes = true;
+            cur++;
+            if (*cur == '\0')
+                continue; // Report the missing `"` on the next iteration.
+        }
+        cur++;
+    }
+
+    std::string_view ret(str_begin, cur - str_begin);
+    cur++; // Skip the `"`.
+    return ret;
+}
+
+std::string_view Json::Reader::SkipNumberRaw(bool &is_real)
+{
+    ParseSkipWhitespace(cur);
+
+    const char *num_begin = cur;
+    is_real = false;
+
+    auto SkipDigits = [&]
+    {
+        const char *digits_begin = cur;
+        while (*cur >= '0' && *cur <= '9')
+            cur++;
+        return cur != digits_begin;
+    };
+
+    if (*cur == '-')
+        cur++;
+    if (!SkipDigits())
+    {
+        cur = num_begin;
+        Error("Expected a number.");
+    }
+
+    if (*cur == '.')
+    {
+        cur++;
+        is_real = true;
+        if (!SkipDigits())
+            Error("Expected a digit after decimal point.");
+    }
+
+    if (*cur == 'e' || *cur == 'E')
+    {
+        cur++;
+        is_real = true;
+        if (*cur == '+' || *cur == '-')
+            cur++;
+        if (!SkipDigits())
+            Error("Expected a digit after `e`, possibly after a sign.");
+    }
+
+    return std::string_view(num_begin, cur - num_begin);
+}
+
+void Json::Reader::UnescapeString(const char *str_begin)
+{
+    cur = str_begin;
+    try
+    {
+        string_buffer = ParseStringLow(cur);
+    }
+    catch (std::exception &e)
+    {
+        Error(e.what());
+    }
+}
+
+void Json::Reader::EnterContainer(char open)
+{
+    ParseSkipWhitespace(cur);
+    if (*cur != open)
+        Error(open == '[' ? "Expected an array." : "Expected an object.");
+    if (depth >= max_depth)
+        Error("Too many nested elements.");
+    depth++;
+    cur++;
+}
+
+bool Json::Reader::NextElement(char close, bool first)
+{
+    ParseSkipWhitespace(cur);
+
+    if (!first && *cur != close)
+    {
+        if (*cur != ',')
+            Error("Expected `,`.");
+        cur++;
+        ParseSkipWhitespace(cur);
+    }
+
+    if (*cur == close)
+    {
+        cur++;
+        return false;
+    }
+
+    if (*cur == '\0')
+        Error(close == ']' ? "This array lacks a terminating `]` character." : "This object lacks a terminating `}` character.");
+
+    return true;
+}
+
+std::string_view Json::Reader::ReadKey()
+{
+    ParseSkipWhitespace(cur);
+    const char *key_begin = cur;
+
+    bool has_escapes = false;
+    std::string_view raw_key = SkipStringRaw(has_escapes);
+    path.push_back({raw_key, -1});
+
+    ParseSkipWhitespace(cur);
+    if (*cur != ':')
+        Error("Expected `:`.");
+    cur++;
+
+    if (!has_escapes)
+        return raw_key;
+
+    const char *old_cur = cur;
+    UnescapeString(key_begin);
+    cur = old_cur;
+    return string_buffer;
+}
+
+Json::type_t Json::Reader::PeekType()
+{
+    ParseSkipWhitespace(cur);
+
+    switch (*cur)
+    {
+      case 'n':
+        return null;
+      case 't':
+      case 'f':
+        return boolean;
+      case '"':
+        return string;
+      case '[':
+        return array;
+      case '{':
+        return object;
+      default:
+        {
+            const char *old_cur = cur;
+            bool is_real = false;
+            (void)SkipNumberRaw(is_real);
+            cur = old_cur;
+            return is_real ? num_real : num_int;
+        }
+    }
+}
+
+void Json::Reader::ReadNull()
+{
+    ParseSkipWhitespace(cur);
+    if (std::strncmp(cur, "null", 4) != 0)
+        Error("Expected `null`.");
+    cur += 4;
+}
+
+bool Json::Reader::ReadBool()
+{
+    ParseSkipWhitespace(cur);
+    if (std::strncmp(cur, "true", 4) == 0)
+    {
+        cur += 4;
+        return true;
+    }
+    if (std::strncmp(cur, "false", 5) == 0)
+    {
+        cur += 5;
+        return false;
+    }
+    Error("Expected a boolean.");
+}
+
+int Json::Reader::ReadInt()
+{
+    bool is_real = false;
+    std::string_view str = SkipNumberRaw(is_real);
+    if (is_real)
+    {
+        cur = str.data();
+        Error("Expected an integer.");
+    }
+
+    bool negative = str[0] == '-';
+    if (negative)
+        str.remove_prefix(1);
+
+    // Accumulate a negative value, because it has a larger range.
+    int ret = 0;
+    for (char ch : str)
+    {
+        int digit = ch - '0';
+        if (ret < (std::numeric_limits<int>::min() + digit) / 10)
+        {
+            cur = str.data();
+            Error("Overflow in integral constant.");
+        }
+        ret = ret * 10 - digit;
+    }
+
+    if (!negative)
+    {
+        if (ret == std::numeric_limits<int>::min())
+        {
+            cur = str.data();
+            Error("Overflow in integral constant.");
+        }
+        ret = -ret;
+    }
+
+    return ret;
+}
+
+double Json::Reader::ReadReal()
+{
+    const char *old_cur = cur;
+    bool is_real = false;
+    std::string_view str = SkipNumberRaw(is_real);
+    if (!is_real)
+    {
+        cur = old_cur;
+        return ReadInt();
+    }
+
+    // `strtod()` needs a null-terminated string, but a number can be followed by anything.
+    char buffer[64];
+    if (str.size() >= sizeof buffer)
+    {
+        cur = str.data();
+        Error("The number is too long.");
+    }
+    std::copy(str.begin(), str.end(), buffer);
+    buffer[str.size()] = '\0';
+
+    return std::strtod(buffer, nullptr);
+}
+
+std::string_view Json::Reader::ReadString()
+{
+    ParseSkipWhitespace(cur);
+    const char *str_begin = cur;
+
+    bool has_escapes = false;
+    std::string_view ret = SkipStringRaw(has_escapes);
+    if (!has_escapes)
+        return ret;
+
+    UnescapeString(str_begin);
+    return string_buffer;
+}
+
+void Json::Reader::ReadIntArray(int *dst, std::size_t count)
+{
+    std::size_t size = 0;
+    ReadArray([&](int index)
+    {
+        if (std::size_t(index) >= count)
+            Error(Str("Expected exactly ", count, " elements."));
+        dst[index] = ReadInt();
+        size++;
+    });
+
+    if (size != count)
+        Error(Str("Expected exactly ", count, " elements, but got ", size, "."));
+}
+
+void Json::Reader::Skip()
+{
+    switch (PeekType())
+    {
+      case null:
+        ReadNull();
+        break;
+      case boolean:
+        (void)ReadBool();
+        break;
+      case num_int:
+      case num_real:
+        {
+            bool is_real = false;
+            (void)SkipNumberRaw(is_real);
+        }
+        break;
+      case string:
+        {
+            bool has_escapes = false;
+            (void)SkipStringRaw(has_escapes);
+        }
+        break;
+      case array:
+        ReadArray([&](int){Skip();});
+        break;
+      case object:
+        ReadObject([&](std::string_view){Skip();});
+        break;
+    }
+}
+
+Json::Reader::Bookmark Json::Reader::SkipToBookmark()
+{
+    DebugAssert("`SkipToBookmark()` must be called from `ReadArray()` or `ReadObject()`.", !path.empty());
+    ParseSkipWhitespace(cur);
+    Bookmark ret{cur, path.back()};
+    Skip();
+    return ret;
+}
+
+void Json::Reader::ExpectEnd()
+{
+    ParseSkipWhitespace(cur);
+    if (*cur != '\0')
+        Error("Unexpected data after JSON.");
+}
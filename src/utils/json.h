@@ -4,6 +4,7 @@
 #include <exception>
 #include <map>
 #include <string>
+#include <string_view>
 #include <variant>
 #include <vector>
 
@@ -210,4 +211,113 @@ class Json
     {
         return View(*this);
     }
+
+    // A streaming JSON reader. Unlike `Json`, it doesn't build a tree, and reads the values in place as you request them.
+    // Doesn't allocate memory, except for strings with escape sequences, and for errors.
+    // The element path and the text position for error messages are only computed when an error is thrown.
+    class Reader
+    {
+        struct PathElem
+        {
+            std::string_view key; // The raw key, without unescaping. Only used if `index` is negative.
+            int index = -1;
+        };
+
+        const char *begin = nullptr;
+        const char *cur = nullptr;
+        int depth = 0, max_depth = 0;
+        std::vector<PathElem> path; // Has `max_depth` reserved elements.
+        std::string string_buffer; // Holds the last string that contained escape sequences.
+
+        // Skips a string without unescaping it. Returns its contents, without quotes. Sets `has_escapes` if it contains backslashes.
+        std::string_view SkipStringRaw(bool &has_escapes);
+        // Skips a number. Returns its text. Sets `is_real` if it has a fractional part or an exponent.
+        std::string_view SkipNumberRaw(bool &is_real);
+
+        // Unescapes the string starting at `str_begin` (at the opening quote) into `string_buffer`. Moves the cursor past the string.
+        void UnescapeString(const char *str_begin);
+
+        void EnterContainer(char open);
+        // Returns false and skips the closing bracket if there are no more elements.
+        bool NextElement(char close, bool first);
+        // Reads an object key and the following `:`, and pushes the key to the path. Returns the unescaped key.
+        std::string_view ReadKey();
+
+      public:
+        struct Bookmark
+        {
+            const char *pos = nullptr;
+            PathElem elem;
+        };
+
+        Reader() {}
+        // The string must be null-terminated, and must remain alive while the reader is used.
+        Reader(const char *string, int allowed_depth);
+
+        // Throws an error with the current position and element path.
+        [[noreturn]] void Error(std::string_view message) const;
+
+        // Returns the type of the next value. Numbers without fractional parts and exponents are reported as `num_int`.
+        [[nodiscard]] type_t PeekType();
+
+        void ReadNull();
+        [[nodiscard]] bool ReadBool();
+        [[nodiscard]] int ReadInt();
+        [[nodiscard]] double ReadReal(); // Also accepts integers.
+        // The result is invalidated by the next call, if the string contains escape sequences.
+        [[nodiscard]] std::string_view ReadString();
+
+        // `func` is `void func(int index)`, it must read or skip the element.
+        template <typename F> void ReadArray(F &&func)
+        {
+            EnterContainer('[');
+            for (int index = 0; NextElement(']', index == 0); index++)
+            {
+                path.push_back({{}, index});
+                func(index);
+                path.pop_back();
+            }
+            depth--;
+        }
+
+        // `func` is `void func(std::string_view key)`, it must read or skip the value.
+        // The key is invalidated by reading a string value, if the key contains escape sequences.
+        template <typename F> void ReadObject(F &&func)
+        {
+            EnterContainer('{');
+            for (bool first = true; NextElement('}', first); first = false)
+            {
+                func(ReadKey());
+                path.pop_back();
+            }
+            depth--;
+        }
+
+        // Reads an array of exactly `count` integers into `dst`.
+        void ReadIntArray(int *dst, std::size_t count);
+
+        // Skips the next value.
+        void Skip();
+
+        // Skips the next value, and returns a bookmark that can be used to read it later with `Revisit()`.
+        // Must be called from a `ReadArray()` or `ReadObject()` callback.
+        [[nodiscard]] Bookmark SkipToBookmark();
+        // Reads a bookmarked value. `func` is `void func()`, it must read or skip the value.
+        // Should be called from the same array or object element that contained the array or object the bookmarked value is in,
+        // otherwise the element paths in the error messages will be wrong.
+        template <typename F> void Revisit(const Bookmark &bookmark, F &&func)
+        {
+            const char *old_cur = cur;
+            cur = bookmark.pos;
+            path.push_back(bookmark.elem);
+            depth++;
+            func();
+            depth--;
+            path.pop_back();
+            cur = old_cur;
+        }
+
+        // Throws if there's anything but whitespace after the current position.
+        void ExpectEnd();
+    };
 };
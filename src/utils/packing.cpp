@@ -8,12 +8,127 @@
 
 namespace Packing
 {
-    int PackRects(ivec2 target_size, Rect *data, int count, int inner_gaps, int outer_gaps)
+    namespace
+    {
+        struct Box
+        {
+            ivec2 a, b; // `b` is exclusive.
+
+            [[nodiscard]] bool Intersects(const Box &other) const
+            {
+                return (a < other.b).all() && (other.a < b).all();
+            }
+
+            [[nodiscard]] bool Contains(const Box &other) const
+            {
+                return (a <= other.a).all() && (other.b <= b).all();
+            }
+        };
+
+        // The max-rects algorithm, with the best-short-side-fit rule.
+        // `target_size` must already be adjusted for the gaps.
+        int PackRectsMaxRects(ivec2 target_size, Rect *data, int count, int inner_gaps, int outer_gaps)
+        {
+            // The largest rectangles go first.
+            std::vector<int> order(count);
+            for (int i = 0; i < count; i++)
+                order[i] = i;
+            std::sort(order.begin(), order.end(), [&](int a, int b)
+            {
+                ivec2 size_a = data[a].size, size_b = data[b].size;
+                return size_a.max() != size_b.max() ? size_a.max() > size_b.max() : size_a.min() > size_b.min();
+            });
+
+            // The maximal free rectangles. They can overlap each other.
+            std::vector<Box> free_boxes = {{ivec2(0), target_size}};
+            std::vector<Box> new_free_boxes;
+
+            int rects_not_packed = 0;
+
+            for (int index : order)
+            {
+                Rect &rect = data[index];
+                ivec2 size = rect.size + inner_gaps;
+
+                // Find the free rectangle where the rectangle fits the most tightly.
+                const Box *best_box = nullptr;
+                ivec2 best_score;
+                for (const Box &box : free_boxes)
+                {
+                    ivec2 leftover = box.b - box.a - size;
+                    if ((leftover < 0).any())
+                        continue;
+
+                    ivec2 score(leftover.min(), leftover.max());
+                    if (!best_box || score.x < best_score.x || (score.x == best_score.x && score.y < best_score.y))
+                    {
+                        best_box = &box;
+                        best_score = score;
+                    }
+                }
+
+                if (!best_box)
+                {
+                    rect.was_packed = false;
+                    rects_not_packed++;
+                    continue;
+                }
+
+                Box placed{best_box->a, best_box->a + size};
+                rect.pos = placed.a + outer_gaps;
+                rect.was_packed = true;
+
+                // Split the free rectangles that intersect the placed one into the parts that remain free.
+                new_free_boxes.clear();
+                for (const Box &box : free_boxes)
+                {
+                    if (!box.Intersects(placed))
+                    {
+                        new_free_boxes.push_back(box);
+                        continue;
+                    }
+
+                    if (placed.a.x > box.a.x)
+                        new_free_boxes.push_back({box.a, ivec2(placed.a.x, box.b.y)});
+                    if (placed.b.x < box.b.x)
+                        new_free_boxes.push_back({ivec2(placed.b.x, box.a.y), box.b});
+                    if (placed.a.y > box.a.y)
+                        new_free_boxes.push_back({box.a, ivec2(box.b.x, placed.a.y)});
+                    if (placed.b.y < box.b.y)
+                        new_free_boxes.push_back({ivec2(box.a.x, placed.b.y), box.b});
+                }
+
+                // Remove the free rectangles that are contained in other ones. Out of several equal ones, the first one is kept.
+                free_boxes.clear();
+                for (std::size_t i = 0; i < new_free_boxes.size(); i++)
+                {
+                    bool redundant = false;
+                    for (std::size_t j = 0; j < new_free_boxes.size(); j++)
+                    {
+                        if (i != j && new_free_boxes[j].Contains(new_free_boxes[i]) && (j < i || !new_free_boxes[i].Contains(new_free_boxes[j])))
+                        {
+                            redundant = true;
+                            break;
+                        }
+                    }
+                    if (!redundant)
+                        free_boxes.push_back(new_free_boxes[i]);
+                }
+            }
+
+            return rects_not_packed;
+        }
+    }
+
+    int PackRects(ivec2 target_size, Rect *data, int count, int inner_gaps, int outer_gaps, Heuristic heuristic)
     {
         // Adjust size.
         target_size -= 2 * outer_gaps;
         target_size += inner_gaps;
 
+        if (heuristic == Heuristic::max_rects)
+            return PackRectsMaxRects(target_size, data, count, inner_gaps, outer_gaps);
+
         // Make rectangle vector.
         std::vector<stbrp_rect> rects(count);
         for (int i = 0; i < count; i++)
@@ -31,6 +146,7 @@ namespace Packing
         // Make a context.
         stbrp_context context;
         stbrp_init_target(&context, target_size.x, target_size.y, packing_buffer.get(), buffer_size); // No cleanup is needed.
+        stbrp_setup_heuristic(&context, heuristic == Heuristic::skyline_best_fit ? STBRP_HEURISTIC_Skyline_BF_sortHeight : STBRP_HEURISTIC_Skyline_BL_sortHeight);
 
         // Try packing.
         bool ok = stbrp_pack_rects(&context, rects.data(), rects.size());
@@ -49,4 +165,126 @@ namespace Packing
 
         return rects_not_packed;
     }
+
+    int PackRectsIntoFreeSpace(ivec2 target_size, const Rect *occupied, int occupied_count, Rect *data, int count, int inner_gaps, int outer_gaps)
+    {
+        // Same as in `PackRects()`, every rectangle is extended by `inner_gaps`, and so is the box.
+        target_size -= 2 * outer_gaps;
+        target_size += inner_gaps;
+
+        std::vector<Box> boxes;
+        boxes.reserve(occupied_count + count);
+        for (int i = 0; i < occupied_count; i++)
+        {
+            ivec2 pos = occupied[i].pos - outer_gaps;
+            boxes.push_back({pos, pos + occupied[i].size + inner_gaps});
+        }
+
+        // The candidate positions are the box corner and the right and bottom edges of the occupied rectangles.
+        std::vector<int> xs = {0}, ys = {0};
+        for (const Box &box : boxes)
+        {
+            xs.push_back(box.b.x);
+            ys.push_back(box.b.y);
+        }
+
+        std::vector<int> order(count);
+        for (int i = 0; i < count; i++)
+            order[i] = i;
+        std::sort(order.begin(), order.end(), [&](int a, int b)
+        {
+            return data[a].size.y != data[b].size.y ? data[a].size.y > data[b].size.y : data[a].size.x > data[b].size.x;
+        });
+
+        int rects_not_packed = 0;
+
+        for (int index : order)
+        {
+            Rect &rect = data[index];
+            ivec2 size = rect.size + inner_gaps;
+            rect.was_packed = false;
+
+            std::sort(xs.begin(), xs.end());
+            xs.erase(std::unique(xs.begin(), xs.end()), xs.end());
+            std::sort(ys.begin(), ys.end());
+            ys.erase(std::unique(ys.begin(), ys.end()), ys.end());
+
+            for (int y : ys)
+            {
+                if (y + size.y > target_size.y)
+                    break;
+
+                for (int x : xs)
+                {
+                    if (x + size.x > target_size.x)
+                        break;
+
+                    Box new_box{ivec2(x, y), ivec2(x, y) + size};
+                    bool overlaps = std::any_of(boxes.begin(), boxes.end(), [&](const Box &box){return box.Intersects(new_box);});
+                    if (overlaps)
+                        continue;
+
+                    rect.pos = new_box.a + outer_gaps;
+                    rect.was_packed = true;
+                    boxes.push_back(new_box);
+                    xs.push_back(new_box.b.x);
+                    ys.push_back(new_box.b.y);
+                    break;
+                }
+
+                if (rect.was_packed)
+                    break;
+            }
+
+            if (!rect.was_packed)
+                rects_not_packed++;
+        }
+
+        return rects_not_packed;
+    }
+
+    int PackRectsWithBestHeuristic(ivec2 target_size, Rect *data, int count, int inner_gaps, int outer_gaps)
+    {
+        // A lower bounding box leaves more contiguous free space, e.g. for incremental atlas updates.
+        std::vector<Rect> rects(data, data + count), best_rects;
+        int best_not_packed = -1;
+        long long best_area = 0;
+        int best_height = 0;
+        for (Heuristic heuristic : {Heuristic::skyline_bottom_left, Heuristic::skyline_best_fit, Heuristic::max_rects})
+        {
+            int not_packed = PackRects(target_size, rects.data(), rects.size(), inner_gaps, outer_gaps, heuristic);
+
+            long long area = 0;
+            int height = 0;
+            for (const Rect &rect : rects)
+            {
+                if (!rect.was_packed)
+                    continue;
+                area += (long long)rect.size.x * rect.size.y;
+                clamp_var_min(height, rect.pos.y + rect.size.y);
+            }
+
+            bool better;
+            if (best_not_packed == -1)
+                better = true;
+            else if ((not_packed == 0) != (best_not_packed == 0))
+                better = not_packed == 0;
+            else if (not_packed == 0)
+                better = height < best_height;
+            else
+                better = area > best_area;
+
+            if (better)
+            {
+                best_not_packed = not_packed;
+                best_area = area;
+                best_height = height;
+                std::swap(rects, best_rects);
+                rects.assign(data, data + count);
+            }
+        }
+
+        std::copy(best_rects.begin(), best_rects.end(), data);
+        return best_not_packed;
+    }
 }
@@ -17,7 +17,23 @@ namespace Packing
         Rect(ivec2 size) : size(size) {}
     };
 
+    enum class Heuristic
+    {
+        skyline_bottom_left, // `stb_rect_pack` default. Sorts rectangles by height, puts each one as low as possible on the skyline.
+        skyline_best_fit, // Same, but prefers the positions that waste the least space under the skyline.
+        max_rects, // Tracks all maximal free rectangles, puts each rectangle where its shorter side fits the most tightly. Slower, but often denser.
+    };
+
     // Returns 0 on success. On failure returns the amount of rectangles that didn't fit into the box.
     // Note that coordinates outside of [0;65535] range are not supported by default. This can be changed in `stb_rect_pack.h`.
-    int PackRects(ivec2 target_size, Rect *data, int count, int inner_gaps = 0, int outer_gaps = 0);
+    int PackRects(ivec2 target_size, Rect *data, int count, int inner_gaps = 0, int outer_gaps = 0, Heuristic heuristic = Heuristic::skyline_bottom_left);
+
+    // Same as `PackRects()`, but tries all heuristics. If several of them succeed, keeps the one with the lowest bounding box.
+    // On failure keeps the one that packs the largest area.
+    int PackRectsWithBestHeuristic(ivec2 target_size, Rect *data, int count, int inner_gaps = 0, int outer_gaps = 0);
+
+    // Same as `PackRects()`, but the box already contains the `occupied` rectangles (with `pos` set), which are not moved.
+    // This is slower and packs less tightly, it's meant for adding a few rectangles to an existing layout.
+    // Uses the bottom-left heuristic: the largest rectangles go first, each to the lowest (then leftmost) position where it fits.
+    int PackRectsIntoFreeSpace(ivec2 target_size, const Rect *occupied, int occupied_count, Rect *data, int count, int inner_gaps = 0, int outer_gaps = 0);
 }
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "macros/finally.h"
+
+/* `ParallelFor(count, func)` calls `func(i)` for every `i` in `[0, count)`, on several threads, and waits for all of them.
+ *
+ * The indices are handed out one by one from a shared counter, so uneven workloads are balanced automatically.
+ * The calling thread does its share of the work too, so no threads are started if `count` is 1 or the hardware has a single core.
+ * If `func` throws, the remaining indices are skipped, and the first exception is rethrown on the calling thread.
+ *
+ * Example usage:
+ *
+ *     std::vector<Image> images(file_names.size());
+ *     ParallelFor(file_names.size(), [&](std::size_t i)
+ *     {
+ *         images[i] = Image(file_names[i]);
+ *     });
+ */
+
+// Returns the amount of threads `ParallelFor()` uses, including the calling thread.
+[[nodiscard]] inline std::size_t ParallelThreadCount()
+{
+    return std::max(1u, std::thread::hardware_concurrency());
+}
+
+template <typename F>
+void ParallelFor(std::size_t count, F &&func) // `func` is `void func(std::size_t i)`.
+{
+    std::atomic<std::size_t> next_index = 0;
+    std::exception_ptr exception;
+    std::mutex exception_mutex;
+
+    auto Work = [&]
+    {
+        while (true)
+        {
+            std::size_t i = next_index.fetch_add(1, std::memory_order_relaxed);
+            if (i >= count)
+                return;
+
+            try
+            {
+                func(i);
+            }
+            catch (...)
+            {
+                std::lock_guard lock(exception_mutex);
+                if (!exception)
+                    exception = std::current_exception();
+                next_index.store(count, std::memory_order_relaxed); // Skip the remaining indices.
+            }
+        }
+    };
+
+    { // Join the threads when leaving this scope, even if starting one of them throws.
+        std::vector<std::thread> threads;
+        FINALLY(
+            for (std::thread &thread : threads)
+                thread.join();
+        )
+        FINALLY_ON_THROW(
+            next_index.store(count, std::memory_order_relaxed); // Don't make the started threads do all the work.
+        )
+
+        std::size_t thread_count = std::min(ParallelThreadCount(), count);
+        if (thread_count > 1)
+        {
+            threads.reserve(thread_count - 1);
+            for (std::size_t i = 1; i < thread_count; i++)
+                threads.emplace_back(Work);
+        }
+
+        Work();
+    }
+
+    if (exception)
+        std::rethrow_exception(exception);
+}
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <type_traits>
+
+/* `SpscQueue<T>` is a fixed-capacity lock-free ring buffer, for exactly one producer thread and one consumer thread.
+ *
+ * Neither side ever blocks: `TryPush` returns false if the queue is full, and `TryPop` returns false if it's empty.
+ * The capacity is rounded up to a power of two.
+ *
+ * Example usage:
+ *
+ *     SpscQueue<int> queue(1024);
+ *     // Producer thread:
+ *     if (!queue.TryPush(42))
+ *         dropped++;
+ *     // Consumer thread:
+ *     int value;
+ *     while (queue.TryPop(value))
+ *         Process(value);
+ */
+
+template <typename T>
+class SpscQueue
+{
+    static_assert(std::is_trivially_copyable_v<T>, "The element type must be trivially copyable.");
+
+    // Keep the two indices on separate cache lines, to avoid false sharing between the threads.
+    static constexpr std::size_t cache_line_size = 64;
+
+    std::unique_ptr<T[]> buffer;
+    std::size_t mask = 0;
+
+    alignas(cache_line_size) std::atomic<std::size_t> write_pos = 0; // Only modified by the producer.
+    alignas(cache_line_size) std::atomic<std::size_t> read_pos = 0; // Only modified by the consumer.
+
+  public:
+    SpscQueue(std::size_t min_capacity)
+    {
+        std::size_t capacity = 1;
+        while (capacity < min_capacity)
+            capacity <<= 1;
+
+        buffer = std::make_unique<T[]>(capacity);
+        mask = capacity - 1;
+    }
+
+    SpscQueue(const SpscQueue &) = delete;
+    SpscQueue &operator=(const SpscQueue &) = delete;
+
+    [[nodiscard]] std::size_t Capacity() const
+    {
+        return mask + 1;
+    }
+
+    // Producer only. Returns false if the queue is full.
+    [[nodiscard]] bool TryPush(const T &value)
+    {
+        std::size_t w = write_pos.load(std::memory_order_relaxed);
+        if (w - read_pos.load(std::memory_order_acquire) > mask)
+            return false;
+
+        buffer[w & mask] = value;
+        write_pos.store(w + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Consumer only. Returns false if the queue is empty.
+    [[nodiscard]] bool TryPop(T &value)
+    {
+        std::size_t r = read_pos.load(std::memory_order_relaxed);
+        if (r == write_pos.load(std::memory_order_acquire))
+            return false;
+
+        value = buffer[r & mask];
+        read_pos.store(r + 1, std::memory_order_release);
+        return true;
+    }
+};